@@ -0,0 +1,101 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QQuickItem>
+#include <QtQml/qqmlregistration.h>
+#include <random>
+#include <vk_renderer/sprite_batch.hpp>
+#include <vk_renderer/vk_renderer.hpp>
+
+// Render thread side of VulkanItem: a VulkanRenderer in external mode on the window's own Vulkan device, queue and
+// command buffer, so there is no second device, no copy and no extra present. Created, used and destroyed on the
+// scene graph's render thread.
+class VulkanItemRenderer : public QObject
+{
+    Q_OBJECT
+
+  public:
+    ~VulkanItemRenderer() override;
+
+    // Called from VulkanItem::sync(), while the GUI thread is blocked.
+    void setWindow( QQuickWindow* window ) { window_ = window; }
+
+    void setSprites( int count, float size );
+
+  public slots:
+    // QQuickWindow::beforeRendering: outside the main render pass. Steps the simulation and lets the renderer
+    // submit uploads and record compute work.
+    void frameStart();
+
+    // QQuickWindow::beforeRenderPassRecording: inside the main render pass, before the scene graph's own content.
+    void mainPassRecordingStart();
+
+  private:
+    bool initialize();
+    void resetSprites( float devicePixelRatio, float width, float height );
+
+    QQuickWindow* window_ = nullptr;
+    VulkanRenderer renderer_;
+    SpriteBatch sprites_;
+    bool failed_ = false;
+
+    int spriteCount_   = 0;
+    float spriteSize_  = 0.0f;
+    bool spritesDirty_ = true;
+    QElapsedTimer clock_; // time since the previous frame
+    std::mt19937 random_{ 12345 };
+};
+
+// Bouncing sprites drawn with VulkanRenderer underneath the window's Qt Quick content. The window must use the
+// Vulkan scene graph backend (QQuickWindow::setGraphicsApi()). The item is meant to fill the window: it renders to
+// all of it, the window's color is the clear color, and opaque items above it hide it.
+//
+// The simulation advances once per frame by the measured frame time, and every swapped frame asks for the next one,
+// so the animation runs at the display's rate with no timer.
+class VulkanItem : public QQuickItem
+{
+    Q_OBJECT
+    QML_ELEMENT
+    Q_PROPERTY( int spriteCount READ spriteCount WRITE setSpriteCount NOTIFY spriteCountChanged )
+    Q_PROPERTY( qreal spriteSize READ spriteSize WRITE setSpriteSize NOTIFY spriteSizeChanged )
+    Q_PROPERTY( qreal fps READ fps NOTIFY fpsChanged )
+
+  public:
+    VulkanItem();
+
+    int spriteCount() const { return spriteCount_; }
+    void setSpriteCount( int count );
+
+    // In device-independent pixels.
+    qreal spriteSize() const { return spriteSize_; }
+    void setSpriteSize( qreal size );
+
+    // Frames swapped per second, updated once a second.
+    qreal fps() const { return fps_; }
+
+  signals:
+    void spriteCountChanged();
+    void spriteSizeChanged();
+    void fpsChanged();
+
+  public slots:
+    void sync();
+    void cleanup();
+
+  private slots:
+    void handleWindowChanged( QQuickWindow* window );
+    void frameSwapped();
+
+  private:
+    void releaseResources() override;
+
+    VulkanItemRenderer* renderer_ = nullptr; // render thread
+
+    int spriteCount_  = 2000;
+    qreal spriteSize_ = 12.0;
+
+    qreal fps_ = 0.0;
+    QElapsedTimer fpsClock_;
+    int fpsFrames_ = 0;
+};
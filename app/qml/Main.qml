@@ -7,38 +7,31 @@ Window {
     width: 600
     height: 400
     visible: true
-    title: "Qt Logo Window"
+    title: "Vulkan under Qt Quick"
+    color: "#202020"
 
-    Rectangle {
+    // Renders underneath everything else in the window, on Qt's own Vulkan device.
+    VulkanItem {
+        id: sprites
         anchors.fill: parent
-        color: "#202020"
-
-        Image {
-            id: logo
-
-            property real vx: 2.5
-            property real vy: 2
-
-            source: "qt_logo.svg"
-            width: 120
-            height: 120
-
-            Timer {
-                interval: 2
-                running: true
-                repeat: true
-
-                onTriggered: {
-                    logo.x += logo.vx
-                    logo.y += logo.vy
+        spriteCount: 2000
+        spriteSize: 12
+    }
 
-                    if (logo.x <= 0 || logo.x + logo.width >= main.width)
-                        logo.vx *= -1
+    Image {
+        source: "qt_logo.svg"
+        width: 48
+        height: 48
+        anchors.right: parent.right
+        anchors.bottom: parent.bottom
+        anchors.margins: 12
+    }
 
-                    if (logo.y <= 0 || logo.y + logo.height >= main.height)
-                        logo.vy *= -1
-                }
-            }
-        }
+    Text {
+        anchors.left: parent.left
+        anchors.top: parent.top
+        anchors.margins: 12
+        color: "white"
+        text: sprites.spriteCount + " sprites, " + sprites.fps.toFixed(0) + " fps"
     }
 }
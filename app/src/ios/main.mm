@@ -28,7 +28,6 @@
 @implementation ViewController
 {
     std::unique_ptr<VulkanRenderer> _renderer;
-    CADisplayLink* _displayLink;
 }
 
 - (void)loadView
@@ -54,11 +53,57 @@
     CGSize size        = self.view.bounds.size;
     layer.drawableSize = CGSizeMake( size.width * scale, size.height * scale );
 
+    NSString* cachesDir = NSSearchPathForDirectoriesInDomains( NSCachesDirectory, NSUserDomainMask, YES ).firstObject;
+    NSString* cachePath = [cachesDir stringByAppendingPathComponent:@"pipeline_cache.bin"];
+
     _renderer = std::make_unique<VulkanRenderer>();
+    _renderer->setPipelineCachePath( cachePath.UTF8String );
     _renderer->init( (__bridge void*)layer, (uint32_t)layer.drawableSize.width, (uint32_t)layer.drawableSize.height );
 
-    _displayLink = [CADisplayLink displayLinkWithTarget:self selector:@selector( tick )];
-    [_displayLink addToRunLoop:[NSRunLoop mainRunLoop] forMode:NSRunLoopCommonModes];
+    // Frames are drawn on the renderer's own thread, paced by presentation, so main run loop work (touch handling,
+    // layout) and rendering cannot hold each other up. On demand: the thread sleeps until something asks for a frame.
+    _renderer->setRenderOnDemand( true );
+    _renderer->startRenderThread();
+
+    // iOS may kill a backgrounded app without ever reaching shutdown(), which is where the cache is saved otherwise.
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector( savePipelineCache )
+                                                 name:UIApplicationDidEnterBackgroundNotification
+                                               object:nil];
+}
+
+- (void)savePipelineCache
+{
+    if( _renderer )
+    {
+        _renderer->savePipelineCache();
+    }
+}
+
+- (void)requestRender
+{
+    if( _renderer )
+    {
+        _renderer->invalidate();
+    }
+}
+
+- (void)touchesBegan:(NSSet<UITouch*>*)touches withEvent:(UIEvent*)event
+{
+    [super touchesBegan:touches withEvent:event];
+    [self requestRender];
+}
+
+- (void)touchesMoved:(NSSet<UITouch*>*)touches withEvent:(UIEvent*)event
+{
+    [super touchesMoved:touches withEvent:event];
+    [self requestRender];
+}
+
+- (void)touchesEnded:(NSSet<UITouch*>*)touches withEvent:(UIEvent*)event
+{
+    [super touchesEnded:touches withEvent:event];
+    [self requestRender];
 }
 
 - (void)viewDidLayoutSubviews
@@ -74,18 +119,11 @@
 
     if( _renderer )
     {
+        // Posted to the render thread, which applies it before its next frame.
         _renderer->resize( (uint32_t)layer.drawableSize.width, (uint32_t)layer.drawableSize.height );
     }
 }
 
-- (void)tick
-{
-    if( _renderer )
-    {
-        _renderer->drawFrame();
-    }
-}
-
 @end
 
 @interface AppDelegate : UIResponder <UIApplicationDelegate>
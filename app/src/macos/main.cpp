@@ -1,4 +1,5 @@
 #define GLFW_INCLUDE_NONE
+#define GLFW_INCLUDE_VULKAN // for glfwInitVulkanLoader()
 #include "backends/imgui_impl_glfw.h"
 #include "backends/imgui_impl_vulkan.h"
 #include "imgui.h"
@@ -8,41 +9,20 @@
 // Include your renderer header
 #include "vk_renderer/vk_renderer.hpp" // adjust to your real path/name
 
-static VkDescriptorPool CreateImGuiDescriptorPool( VkDevice device )
+static void RequestFrames( GLFWwindow* window )
 {
-    // Big-ish pool for ImGui. This is the standard approach in many samples.
-    VkDescriptorPoolSize poolSizes[] = {
-        { VK_DESCRIPTOR_TYPE_SAMPLER, 1000 },
-        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000 },
-        { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1000 },
-        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1000 },
-        { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1000 },
-        { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 1000 },
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1000 },
-        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1000 },
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1000 },
-        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1000 },
-        { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1000 },
-    };
-
-    VkDescriptorPoolCreateInfo ci{};
-    ci.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    ci.flags         = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-    ci.maxSets       = 1000 * (uint32_t)( sizeof( poolSizes ) / sizeof( poolSizes[0] ) );
-    ci.poolSizeCount = (uint32_t)( sizeof( poolSizes ) / sizeof( poolSizes[0] ) );
-    ci.pPoolSizes    = poolSizes;
-
-    VkDescriptorPool pool = VK_NULL_HANDLE;
-    VkResult r            = vkCreateDescriptorPool( device, &ci, nullptr, &pool );
-    if( r != VK_SUCCESS )
-    {
-        std::fprintf( stderr, "Failed to create ImGui descriptor pool: %d\n", (int)r );
-    }
-    return pool;
+    static_cast<VulkanRenderer*>( glfwGetWindowUserPointer( window ) )->invalidate( 2 );
 }
 
 int main()
 {
+#if defined( VK_NO_PROTOTYPES )
+    // Dynamic loader build: GLFW must go through the library the renderer loads instead of opening its own.
+    if( !loadVulkanLibrary() )
+        return 1;
+    glfwInitVulkanLoader( vkGetInstanceProcAddr );
+#endif
+
     if( !glfwInit() )
     {
         std::fprintf( stderr, "glfwInit failed\n" );
@@ -58,6 +38,7 @@ int main()
     }
 
     VulkanRenderer renderer;
+    renderer.setPipelineCachePath( "pipeline_cache.bin" );
     if( !renderer.initGlfw( window ) )
     {
         std::fprintf( stderr, "renderer.initGlfw failed\n" );
@@ -70,9 +51,38 @@ int main()
     ImGuiIO& io = ImGui::GetIO();
     (void)io;
 
+    // Render on demand: input redraws, an idle window costs nothing. ImGui chains to callbacks installed before its
+    // own. Two frames per event, since ImGui reacts to some input (hover, release) one frame late.
+    glfwSetWindowUserPointer( window, &renderer );
+    renderer.setRenderOnDemand( true );
+    glfwSetCursorPosCallback( window, []( GLFWwindow* w, double, double ) { RequestFrames( w ); } );
+    glfwSetMouseButtonCallback( window, []( GLFWwindow* w, int, int, int ) { RequestFrames( w ); } );
+    glfwSetScrollCallback( window, []( GLFWwindow* w, double, double ) { RequestFrames( w ); } );
+    glfwSetKeyCallback( window, []( GLFWwindow* w, int, int, int, int ) { RequestFrames( w ); } );
+    glfwSetCharCallback( window, []( GLFWwindow* w, unsigned int ) { RequestFrames( w ); } );
+    glfwSetWindowFocusCallback( window, []( GLFWwindow* w, int ) { RequestFrames( w ); } );
+
+    // Live resize sends a new size on nearly every frame; the renderer's resize policy coalesces them.
+    glfwSetFramebufferSizeCallback( window,
+                                    []( GLFWwindow* w, int width, int height )
+                                    {
+                                        auto* r = static_cast<VulkanRenderer*>( glfwGetWindowUserPointer( w ) );
+                                        r->resize( (uint32_t)width, (uint32_t)height );
+                                    } );
+
     ImGui_ImplGlfw_InitForVulkan( window, true );
 
-    VkDescriptorPool imguiPool = CreateImGuiDescriptorPool( renderer.device() );
+    // ImGui allocates and frees its own sets (the font atlas, plus one per AddTexture) from a single pool, so it gets a
+    // standalone one sized for that rather than sets from the shared lists. The renderer destroys it at shutdown.
+    VkDescriptorPool imguiPool = renderer.descriptors().createPool( { { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 64 } }, 64,
+                                                                    VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT );
+
+#if defined( VK_NO_PROTOTYPES )
+    // ImGui's backend has no prototypes either; it fetches its functions through the renderer's instance.
+    ImGui_ImplVulkan_LoadFunctions( []( const char* name, void* instance )
+                                    { return vkGetInstanceProcAddr( static_cast<VkInstance>( instance ), name ); },
+                                    renderer.instance() );
+#endif
 
     ImGui_ImplVulkan_InitInfo initInfo{};
     initInfo.Instance       = renderer.instance();
@@ -84,6 +94,7 @@ int main()
     initInfo.MinImageCount  = renderer.minImageCount();
     initInfo.ImageCount     = renderer.imageCount();
     initInfo.RenderPass     = renderer.renderPass();
+    initInfo.PipelineCache  = renderer.pipelineCache();
     ImGui_ImplVulkan_Init( &initInfo );
 
     ImGui_ImplVulkan_CreateFontsTexture();
@@ -95,7 +106,28 @@ int main()
 
     while( !glfwWindowShouldClose( window ) )
     {
-        glfwPollEvents();
+        // Sleep until an event arrives when there is nothing to redraw. Frames still in flight only allow a short
+        // nap: their deferred destruction and captures run from idle drawFrame() calls.
+        const bool inFlight = renderer.completedFrameNumber() < renderer.frameNumber();
+        if( renderer.needsFrame() )
+        {
+            glfwPollEvents();
+        }
+        else if( inFlight )
+        {
+            glfwWaitEventsTimeout( 0.001 );
+        }
+        else
+        {
+            glfwWaitEvents();
+        }
+
+        if( !renderer.needsFrame() )
+        {
+            if( inFlight )
+                renderer.drawFrame(); // renders nothing; retires the frames the GPU has finished
+            continue;
+        }
 
         ImGui_ImplVulkan_NewFrame();
         ImGui_ImplGlfw_NewFrame();
@@ -111,13 +143,12 @@ int main()
         renderer.drawFrame();
     }
 
-    vkDeviceWaitIdle( renderer.device() );
-    ImGui_ImplVulkan_Shutdown();
+    // The last frames may still be in flight; shutdown() idles the device once and then runs this.
+    renderer.deferDestroy( [] { ImGui_ImplVulkan_Shutdown(); } );
+    renderer.shutdown();
+
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
-    vkDestroyDescriptorPool( renderer.device(), imguiPool, nullptr );
-
-    renderer.shutdown();
     glfwDestroyWindow( window );
     glfwTerminate();
     return 0;
@@ -1,11 +1,16 @@
 #include <QApplication>
 #include <QDir>
 #include <QQmlApplicationEngine>
+#include <QQuickWindow>
+#include <QSGRendererInterface>
 
 int main( int argc, char* argv[] )
 {
     QApplication app( argc, argv );
 
+    // VulkanItem renders with Qt's own Vulkan device.
+    QQuickWindow::setGraphicsApi( QSGRendererInterface::Vulkan );
+
     QQmlApplicationEngine engine;
     engine.loadFromModule( "app", "Main" );
 
@@ -0,0 +1,247 @@
+#include "vulkan_item.hpp"
+
+#include <QQuickWindow>
+#include <QRunnable>
+#include <QSGRendererInterface>
+#include <QVulkanInstance>
+#include <algorithm>
+
+// Longer gaps (a stalled or hidden window) would make sprites jump; they step at most this far.
+static constexpr float kMaxStepSeconds = 0.1f;
+
+// Deletes the renderer on the render thread, where its Vulkan objects live.
+class CleanupJob : public QRunnable
+{
+  public:
+    explicit CleanupJob( VulkanItemRenderer* renderer )
+        : renderer_( renderer )
+    {
+    }
+
+    void run() override { delete renderer_; }
+
+  private:
+    VulkanItemRenderer* renderer_;
+};
+
+template <typename T>
+static T rendererResource( QQuickWindow* window, QSGRendererInterface::Resource resource )
+{
+    return *static_cast<T*>( window->rendererInterface()->getResource( window, resource ) );
+}
+
+// --- VulkanItemRenderer ---
+
+VulkanItemRenderer::~VulkanItemRenderer()
+{
+    sprites_.destroy();
+    renderer_.shutdown();
+}
+
+void VulkanItemRenderer::setSprites( int count, float size )
+{
+    count = std::max( count, 0 );
+    if( count != spriteCount_ || size != spriteSize_ )
+    {
+        spriteCount_  = count;
+        spriteSize_   = size;
+        spritesDirty_ = true;
+    }
+}
+
+bool VulkanItemRenderer::initialize()
+{
+    QSGRendererInterface* rif = window_->rendererInterface();
+    if( rif->graphicsApi() != QSGRendererInterface::Vulkan )
+    {
+        qWarning( "VulkanItem needs the Vulkan scene graph backend; nothing is drawn." );
+        return false;
+    }
+
+    auto* instance = static_cast<QVulkanInstance*>( rif->getResource( window_, QSGRendererInterface::VulkanInstanceResource ) );
+
+    VulkanRenderer::ExternalDevice host;
+    host.instance         = instance->vkInstance();
+    host.physicalDevice   = rendererResource<VkPhysicalDevice>( window_, QSGRendererInterface::PhysicalDeviceResource );
+    host.device           = rendererResource<VkDevice>( window_, QSGRendererInterface::DeviceResource );
+    host.queue            = rendererResource<VkQueue>( window_, QSGRendererInterface::CommandQueueResource );
+    host.queueFamilyIndex = rendererResource<uint32_t>( window_, QSGRendererInterface::GraphicsQueueFamilyIndexResource );
+    host.framesInFlight   = static_cast<uint32_t>( window_->graphicsStateInfo().framesInFlight );
+    if( !renderer_.initExternal( host ) )
+        return false;
+
+    if( !sprites_.create( renderer_, static_cast<uint32_t>( std::max( spriteCount_, 1 ) ) ) )
+        return false;
+    renderer_.setRecordCallback( [this]( VkCommandBuffer cmd ) { sprites_.record( cmd ); } );
+
+    clock_.start();
+    return true;
+}
+
+void VulkanItemRenderer::resetSprites( float devicePixelRatio, float width, float height )
+{
+    spritesDirty_ = false;
+
+    // Capacity is fixed per batch; the old one is released once the frames using it are done.
+    const uint32_t count = static_cast<uint32_t>( spriteCount_ );
+    if( count > sprites_.capacity() )
+    {
+        sprites_.destroy();
+        if( !sprites_.create( renderer_, count ) )
+        {
+            failed_ = true;
+            return;
+        }
+    }
+
+    const float size = spriteSize_ * devicePixelRatio;
+    sprites_.setSpriteSize( size, size );
+    sprites_.clear();
+
+    std::uniform_real_distribution<float> across( 0.0f, width );
+    std::uniform_real_distribution<float> down( 0.0f, height );
+    std::uniform_real_distribution<float> speed( -400.0f * devicePixelRatio, 400.0f * devicePixelRatio );
+    std::uniform_int_distribution<uint32_t> rgb( 0, 0x00FFFFFFu );
+    for( uint32_t i = 0; i < count; ++i )
+    {
+        sprites_.add( across( random_ ), down( random_ ), speed( random_ ), speed( random_ ), 0xFF000000u | rgb( random_ ) );
+    }
+}
+
+void VulkanItemRenderer::frameStart()
+{
+    if( failed_ || window_ == nullptr )
+        return;
+
+    if( !renderer_.isExternal() && !initialize() )
+    {
+        failed_ = true;
+        return;
+    }
+
+    const float dpr    = static_cast<float>( window_->effectiveDevicePixelRatio() );
+    const float width  = static_cast<float>( window_->width() ) * dpr;
+    const float height = static_cast<float>( window_->height() ) * dpr;
+    if( spritesDirty_ )
+    {
+        resetSprites( dpr, width, height );
+        if( failed_ )
+            return;
+    }
+
+    // One step per frame by the time since the previous one, so the motion follows the display rate.
+    const float dt = std::min( static_cast<float>( clock_.nsecsElapsed() ) * 1e-9f, kMaxStepSeconds );
+    clock_.restart();
+    sprites_.setBounds( width, height );
+    sprites_.update( dt );
+
+    const auto cmd  = rendererResource<VkCommandBuffer>( window_, QSGRendererInterface::CommandListResource );
+    const auto slot = static_cast<uint32_t>( window_->graphicsStateInfo().currentFrameSlot );
+
+    window_->beginExternalCommands();
+    renderer_.beginExternalFrame( cmd, slot );
+    window_->endExternalCommands();
+}
+
+void VulkanItemRenderer::mainPassRecordingStart()
+{
+    if( failed_ || !renderer_.isExternal() )
+        return;
+
+    const auto cmd        = rendererResource<VkCommandBuffer>( window_, QSGRendererInterface::CommandListResource );
+    const auto renderPass = rendererResource<VkRenderPass>( window_, QSGRendererInterface::RenderPassResource );
+    const QSize size      = window_->size() * window_->effectiveDevicePixelRatio();
+    const VkExtent2D extent{ static_cast<uint32_t>( size.width() ), static_cast<uint32_t>( size.height() ) };
+
+    // Qt does not expose its swapchain format; the sprite pipeline only needs the render pass.
+    window_->beginExternalCommands();
+    renderer_.recordExternalFrame( cmd, renderPass, VK_FORMAT_UNDEFINED, extent );
+    window_->endExternalCommands();
+}
+
+// --- VulkanItem ---
+
+VulkanItem::VulkanItem()
+{
+    connect( this, &QQuickItem::windowChanged, this, &VulkanItem::handleWindowChanged );
+}
+
+void VulkanItem::setSpriteCount( int count )
+{
+    if( count == spriteCount_ )
+        return;
+
+    spriteCount_ = count;
+    emit spriteCountChanged();
+    if( window() )
+        window()->update();
+}
+
+void VulkanItem::setSpriteSize( qreal size )
+{
+    if( size == spriteSize_ )
+        return;
+
+    spriteSize_ = size;
+    emit spriteSizeChanged();
+    if( window() )
+        window()->update();
+}
+
+void VulkanItem::handleWindowChanged( QQuickWindow* window )
+{
+    if( window == nullptr )
+        return;
+
+    connect( window, &QQuickWindow::beforeSynchronizing, this, &VulkanItem::sync, Qt::DirectConnection );
+    connect( window, &QQuickWindow::sceneGraphInvalidated, this, &VulkanItem::cleanup, Qt::DirectConnection );
+
+    // Emitted on the render thread once a frame is presented; handled here on the GUI thread.
+    connect( window, &QQuickWindow::frameSwapped, this, &VulkanItem::frameSwapped, Qt::QueuedConnection );
+}
+
+// Render thread, while the GUI thread is blocked.
+void VulkanItem::sync()
+{
+    if( renderer_ == nullptr )
+    {
+        renderer_ = new VulkanItemRenderer;
+        connect( window(), &QQuickWindow::beforeRendering, renderer_, &VulkanItemRenderer::frameStart, Qt::DirectConnection );
+        connect( window(), &QQuickWindow::beforeRenderPassRecording, renderer_, &VulkanItemRenderer::mainPassRecordingStart,
+                 Qt::DirectConnection );
+    }
+    renderer_->setWindow( window() );
+    renderer_->setSprites( spriteCount_, static_cast<float>( spriteSize_ ) );
+}
+
+// Render thread, when the scene graph releases its graphics resources; the device is still alive.
+void VulkanItem::cleanup()
+{
+    delete renderer_;
+    renderer_ = nullptr;
+}
+
+void VulkanItem::releaseResources()
+{
+    window()->scheduleRenderJob( new CleanupJob( renderer_ ), QQuickWindow::BeforeSynchronizingStage );
+    renderer_ = nullptr;
+}
+
+void VulkanItem::frameSwapped()
+{
+    ++fpsFrames_;
+    if( !fpsClock_.isValid() )
+    {
+        fpsClock_.start();
+    }
+    else if( fpsClock_.elapsed() >= 1000 )
+    {
+        fps_       = fpsFrames_ * 1000.0 / static_cast<qreal>( fpsClock_.restart() );
+        fpsFrames_ = 0;
+        emit fpsChanged();
+    }
+
+    // Presentation is paced by the display, so asking for the next frame here ticks at its refresh rate.
+    if( window() )
+        window()->update();
+}
@@ -0,0 +1,377 @@
+// VulkanRenderer benchmarks, headless, printed as one JSON object on stdout so that runs can be stored and compared
+// between releases. Progress and errors go to stderr.
+//
+//   vk_renderer_bench [frames = 500] [init_runs = 5] [heavy_commands = 20000]
+//
+// Sections:
+//   init         initHeadless() (instance, device, subsystems, targets), the first frame, and shutdown(), per run
+//   recreate     target rebuild after a resize (FramePhase::Recreate), and the drawFrame() doing it, per recreation
+//   frames       drawFrame() wall time with no record callback ("empty"), with a callback recording heavy_commands
+//                dynamic state commands ("heavy"), with the same callback calling through renderer.dispatch() instead
+//                of the loader's entry points ("heavy_dispatch"), and with the commands split over record jobs
+//                ("heavy_jobs")
+//   allocations  heap allocations (operator new) per steady-state frame of each frames scenario, and the live
+//                vkAllocateMemory count of the GPU allocator
+//
+// Times are milliseconds. With a software ICD (VK_ICD_FILENAMES pointing at lavapipe or SwiftShader) frame times
+// include its rasterizer, so compare runs on the same machine and ICD only.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include <vk_renderer/vk_renderer.hpp>
+#include <vk_renderer/worker_pool.hpp>
+
+using Clock = std::chrono::steady_clock;
+
+// --- Heap allocation counting ---
+
+static std::atomic<uint64_t> gHeapAllocations{ 0 };
+
+void* operator new( size_t size )
+{
+    gHeapAllocations.fetch_add( 1, std::memory_order_relaxed );
+    if( void* p = std::malloc( size != 0 ? size : 1 ) )
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete( void* p ) noexcept
+{
+    std::free( p );
+}
+
+void operator delete( void* p, size_t ) noexcept
+{
+    std::free( p );
+}
+
+// --- Statistics ---
+
+struct Summary
+{
+    size_t samples = 0;
+    double minMs   = 0.0;
+    double avgMs   = 0.0;
+    double p50Ms   = 0.0;
+    double p95Ms   = 0.0;
+    double p99Ms   = 0.0;
+    double maxMs   = 0.0;
+};
+
+static double msSince( Clock::time_point start )
+{
+    return std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+}
+
+static Summary summarize( std::vector<double> ms )
+{
+    Summary s;
+    s.samples = ms.size();
+    if( ms.empty() )
+        return s;
+
+    std::sort( ms.begin(), ms.end() );
+    auto percentile = [&]( double p ) {
+        return ms[std::min( ms.size() - 1, static_cast<size_t>( p * static_cast<double>( ms.size() ) ) )];
+    };
+
+    double total = 0.0;
+    for( double v : ms )
+        total += v;
+
+    s.minMs = ms.front();
+    s.avgMs = total / static_cast<double>( ms.size() );
+    s.p50Ms = percentile( 0.50 );
+    s.p95Ms = percentile( 0.95 );
+    s.p99Ms = percentile( 0.99 );
+    s.maxMs = ms.back();
+    return s;
+}
+
+// --- JSON output ---
+
+static std::string jsonString( const char* text )
+{
+    std::string out = "\"";
+    for( const char* c = text; *c != '\0'; ++c )
+    {
+        if( *c == '"' || *c == '\\' )
+        {
+            out += '\\';
+            out += *c;
+        }
+        else if( static_cast<unsigned char>( *c ) < 0x20 )
+        {
+            char escaped[8];
+            std::snprintf( escaped, sizeof( escaped ), "\\u%04x", static_cast<unsigned>( *c ) );
+            out += escaped;
+        }
+        else
+        {
+            out += *c;
+        }
+    }
+    return out + "\"";
+}
+
+static std::string jsonSummary( const Summary& s )
+{
+    char buffer[256];
+    std::snprintf( buffer, sizeof( buffer ),
+                   "{ \"samples\": %zu, \"min_ms\": %.4f, \"avg_ms\": %.4f, \"p50_ms\": %.4f, \"p95_ms\": %.4f, \"p99_ms\": %.4f, "
+                   "\"max_ms\": %.4f }",
+                   s.samples, s.minMs, s.avgMs, s.p50Ms, s.p95Ms, s.p99Ms, s.maxMs );
+    return buffer;
+}
+
+// Average of one phase over the renderer's recent frames, or null when it was not measured.
+static std::string jsonPhaseAvg( const FrameStats& stats, FramePhase phase )
+{
+    if( stats[phase].samples == 0 )
+        return "null";
+
+    char buffer[32];
+    std::snprintf( buffer, sizeof( buffer ), "%.4f", stats[phase].avgMs );
+    return buffer;
+}
+
+// --- Benchmarks ---
+
+static constexpr uint32_t kWidth  = 1280;
+static constexpr uint32_t kHeight = 720;
+
+struct InitResult
+{
+    std::vector<double> initMs;
+    std::vector<double> firstFrameMs;
+    std::vector<double> shutdownMs;
+    std::string deviceName;
+    uint32_t apiVersion = 0;
+};
+
+static bool benchInit( uint32_t runs, InitResult& result )
+{
+    for( uint32_t i = 0; i < runs; ++i )
+    {
+        VulkanRenderer renderer;
+
+        auto start = Clock::now();
+        if( !renderer.initHeadless( kWidth, kHeight ) )
+            return false;
+        result.initMs.push_back( msSince( start ) );
+
+        start = Clock::now();
+        renderer.drawFrame();
+        renderer.waitForFrame( renderer.frameNumber() );
+        result.firstFrameMs.push_back( msSince( start ) );
+
+        result.deviceName = renderer.deviceCaps().properties.deviceName;
+        result.apiVersion = renderer.deviceCaps().properties.apiVersion;
+
+        start = Clock::now();
+        renderer.shutdown();
+        result.shutdownMs.push_back( msSince( start ) );
+    }
+    return true;
+}
+
+// Alternates between two sizes with the resize policy's coalescing off, so every frame rebuilds the targets.
+// rebuildMs is the rebuild itself; frameMs the whole drawFrame() that did it, i.e. from resize() to the first frame
+// at the new size being submitted.
+static void benchRecreate( VulkanRenderer& renderer, uint32_t recreations, std::vector<double>& rebuildMs, std::vector<double>& frameMs )
+{
+    VulkanRenderer::ResizePolicy policy;
+    policy.settleMs      = 0;
+    policy.minIntervalMs = 0;
+    renderer.setResizePolicy( policy );
+
+    for( uint32_t i = 0; i < recreations; ++i )
+    {
+        const uint64_t before = renderer.resizeStats().recreations;
+        const auto start      = Clock::now();
+        renderer.resize( i % 2 == 0 ? kWidth / 2 : kWidth, i % 2 == 0 ? kHeight / 2 : kHeight );
+        renderer.drawFrame();
+        const double ms = msSince( start );
+        if( renderer.resizeStats().recreations > before )
+        {
+            rebuildMs.push_back( renderer.resizeStats().recreateMs );
+            frameMs.push_back( ms );
+        }
+    }
+
+    renderer.resize( kWidth, kHeight );
+    renderer.drawFrame();
+    renderer.setResizePolicy( VulkanRenderer::ResizePolicy{} );
+}
+
+struct FrameResult
+{
+    Summary wall;
+    double framesPerSecond     = 0.0;
+    double heapAllocsPerFrame  = 0.0;
+    uint32_t deviceMemoryCount = 0;
+    FrameStats stats;
+};
+
+static FrameResult benchFrames( VulkanRenderer& renderer, uint32_t frames )
+{
+    // Warm up: pools, descriptor sets and per-slot buffers reach their steady-state sizes.
+    for( uint32_t i = 0; i < 2 * VulkanRenderer::kMaxFramesInFlight + 2; ++i )
+    {
+        renderer.drawFrame();
+    }
+    renderer.waitForFrame( renderer.frameNumber() );
+
+    std::vector<double> ms;
+    ms.reserve( frames );
+
+    const uint64_t allocsBefore = gHeapAllocations.load( std::memory_order_relaxed );
+    const auto start            = Clock::now();
+    for( uint32_t i = 0; i < frames; ++i )
+    {
+        const auto frameStart = Clock::now();
+        renderer.drawFrame();
+        ms.push_back( msSince( frameStart ) );
+    }
+    renderer.waitForFrame( renderer.frameNumber() );
+    const double totalMs       = msSince( start );
+    const uint64_t allocsAfter = gHeapAllocations.load( std::memory_order_relaxed );
+
+    FrameResult result;
+    result.wall               = summarize( std::move( ms ) );
+    result.framesPerSecond    = 1000.0 * frames / totalMs;
+    result.heapAllocsPerFrame = static_cast<double>( allocsAfter - allocsBefore ) / frames;
+    result.deviceMemoryCount  = renderer.allocator().stats().deviceMemoryCount;
+    result.stats              = renderer.frameStats();
+    return result;
+}
+
+// CPU-heavy, GPU-light recording: dynamic state only, so no pipeline or shaders are needed. Without a dispatch table
+// the commands go through the loader's entry points.
+static void recordStateCommands( VkCommandBuffer cmd, uint32_t count, const DeviceDispatch* dispatch = nullptr )
+{
+    const PFN_vkCmdSetViewport setViewport = dispatch ? dispatch->vkCmdSetViewport : vkCmdSetViewport;
+    const PFN_vkCmdSetScissor setScissor   = dispatch ? dispatch->vkCmdSetScissor : vkCmdSetScissor;
+
+    VkViewport viewport{};
+    viewport.width    = static_cast<float>( kWidth );
+    viewport.height   = static_cast<float>( kHeight );
+    viewport.maxDepth = 1.0f;
+    VkRect2D scissor{ { 0, 0 }, { kWidth, kHeight } };
+
+    for( uint32_t i = 0; i < count; i += 2 )
+    {
+        setViewport( cmd, 0, 1, &viewport );
+        setScissor( cmd, 0, 1, &scissor );
+    }
+}
+
+static void printFrames( const char* name, const FrameResult& r, uint32_t commands, bool last )
+{
+    std::printf( "    %s: {\n", jsonString( name ).c_str() );
+    std::printf( "      \"commands_per_frame\": %u,\n", commands );
+    std::printf( "      \"frames_per_second\": %.2f,\n", r.framesPerSecond );
+    std::printf( "      \"draw_frame\": %s,\n", jsonSummary( r.wall ).c_str() );
+    std::printf( "      \"record_avg_ms\": %s,\n", jsonPhaseAvg( r.stats, FramePhase::Record ).c_str() );
+    std::printf( "      \"fence_wait_avg_ms\": %s,\n", jsonPhaseAvg( r.stats, FramePhase::FenceWait ).c_str() );
+    std::printf( "      \"gpu_avg_ms\": %s\n", jsonPhaseAvg( r.stats, FramePhase::Gpu ).c_str() );
+    std::printf( "    }%s\n", last ? "" : "," );
+}
+
+int main( int argc, char* argv[] )
+{
+    const uint32_t frames   = argc > 1 ? static_cast<uint32_t>( std::strtoul( argv[1], nullptr, 10 ) ) : 500;
+    const uint32_t initRuns = argc > 2 ? static_cast<uint32_t>( std::strtoul( argv[2], nullptr, 10 ) ) : 5;
+    const uint32_t commands = argc > 3 ? static_cast<uint32_t>( std::strtoul( argv[3], nullptr, 10 ) ) : 20000;
+    if( frames == 0 || initRuns == 0 )
+    {
+        std::fprintf( stderr, "usage: %s [frames] [init_runs] [heavy_commands]\n", argv[0] );
+        return 1;
+    }
+
+    std::fprintf( stderr, "init: %u runs\n", initRuns );
+    InitResult init;
+    if( !benchInit( initRuns, init ) )
+    {
+        std::fprintf( stderr, "Headless init failed.\n" );
+        return 1;
+    }
+
+    VulkanRenderer renderer;
+    if( !renderer.initHeadless( kWidth, kHeight ) )
+    {
+        std::fprintf( stderr, "Headless init failed.\n" );
+        return 1;
+    }
+
+    std::fprintf( stderr, "recreate\n" );
+    std::vector<double> rebuildMs;
+    std::vector<double> resizeFrameMs;
+    benchRecreate( renderer, std::max( 10u, frames / 10 ), rebuildMs, resizeFrameMs );
+
+    std::fprintf( stderr, "frames: empty\n" );
+    const FrameResult empty = benchFrames( renderer, frames );
+
+    std::fprintf( stderr, "frames: heavy\n" );
+    renderer.setRecordCallback( [commands]( VkCommandBuffer cmd ) { recordStateCommands( cmd, commands ); } );
+    const FrameResult heavy = benchFrames( renderer, frames );
+
+    std::fprintf( stderr, "frames: heavy_dispatch\n" );
+    renderer.setRecordCallback( [commands, &renderer]( VkCommandBuffer cmd )
+                                { recordStateCommands( cmd, commands, &renderer.dispatch() ); } );
+    const FrameResult heavyDispatch = benchFrames( renderer, frames );
+    renderer.setRecordCallback( nullptr );
+
+    // One job per recording thread (the pool's workers plus the thread calling drawFrame()).
+    const uint32_t jobs = WorkerPool::defaultWorkerCount() + 1;
+    std::fprintf( stderr, "frames: heavy_jobs (%u jobs)\n", jobs );
+    for( uint32_t i = 0; i < jobs; ++i )
+    {
+        renderer.addRecordJob( [commands, jobs]( VkCommandBuffer cmd ) { recordStateCommands( cmd, commands / jobs ); } );
+    }
+    const FrameResult heavyJobs = benchFrames( renderer, frames );
+    renderer.clearRecordJobs();
+
+    const uint32_t framesInFlight = renderer.framesInFlight();
+    renderer.shutdown();
+
+    std::printf( "{\n" );
+    std::printf( "  \"benchmark\": \"vk_renderer_bench\",\n" );
+    std::printf( "  \"schema\": 1,\n" );
+    std::printf( "  \"device\": %s,\n", jsonString( init.deviceName.c_str() ).c_str() );
+    std::printf( "  \"device_api_version\": \"%u.%u.%u\",\n", VK_API_VERSION_MAJOR( init.apiVersion ),
+                 VK_API_VERSION_MINOR( init.apiVersion ), VK_API_VERSION_PATCH( init.apiVersion ) );
+    std::printf( "  \"width\": %u,\n", kWidth );
+    std::printf( "  \"height\": %u,\n", kHeight );
+    std::printf( "  \"frames_per_scenario\": %u,\n", frames );
+    std::printf( "  \"frames_in_flight\": %u,\n", framesInFlight );
+    std::printf( "  \"init\": {\n" );
+    std::printf( "    \"init_headless\": %s,\n", jsonSummary( summarize( init.initMs ) ).c_str() );
+    std::printf( "    \"first_frame\": %s,\n", jsonSummary( summarize( init.firstFrameMs ) ).c_str() );
+    std::printf( "    \"shutdown\": %s\n", jsonSummary( summarize( init.shutdownMs ) ).c_str() );
+    std::printf( "  },\n" );
+    std::printf( "  \"recreate\": {\n" );
+    std::printf( "    \"rebuild\": %s,\n", jsonSummary( summarize( rebuildMs ) ).c_str() );
+    std::printf( "    \"resize_frame\": %s\n", jsonSummary( summarize( resizeFrameMs ) ).c_str() );
+    std::printf( "  },\n" );
+    std::printf( "  \"frames\": {\n" );
+    printFrames( "empty", empty, 0, false );
+    printFrames( "heavy", heavy, commands, false );
+    printFrames( "heavy_dispatch", heavyDispatch, commands, false );
+    printFrames( "heavy_jobs", heavyJobs, commands / jobs * jobs, true );
+    std::printf( "  },\n" );
+    std::printf( "  \"allocations\": {\n" );
+    std::printf( "    \"heap_per_frame\": { \"empty\": %.2f, \"heavy\": %.2f, \"heavy_dispatch\": %.2f, \"heavy_jobs\": %.2f },\n",
+                 empty.heapAllocsPerFrame, heavy.heapAllocsPerFrame, heavyDispatch.heapAllocsPerFrame, heavyJobs.heapAllocsPerFrame );
+    std::printf( "    \"device_memory_count\": %u\n", heavyJobs.deviceMemoryCount );
+    std::printf( "  }\n" );
+    std::printf( "}\n" );
+    return 0;
+}
@@ -0,0 +1,134 @@
+// SpriteBatch throughput, headless.
+//
+//   vk_renderer_sprite_bench [sprites = 1000000] [frames = 300]
+//
+// Reports the SIMD physics on its own (single-threaded, and on a worker pool when there is more than one core), then
+// full frames: update(), streaming into the instance buffer and the
+// instanced draw. Frame times include waiting for the GPU once the frame ring is full, so with a software ICD they
+// mostly measure its rasterizer.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vk_renderer/sprite_batch.hpp>
+#include <vk_renderer/vk_renderer.hpp>
+#include <vk_renderer/worker_pool.hpp>
+
+using Clock = std::chrono::steady_clock;
+
+static double msSince( Clock::time_point start )
+{
+    return std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+}
+
+int main( int argc, char* argv[] )
+{
+    const uint32_t sprites = argc > 1 ? static_cast<uint32_t>( std::strtoul( argv[1], nullptr, 10 ) ) : 1000000;
+    const uint32_t frames  = argc > 2 ? static_cast<uint32_t>( std::strtoul( argv[2], nullptr, 10 ) ) : 300;
+    if( sprites == 0 || frames == 0 )
+    {
+        std::fprintf( stderr, "usage: %s [sprites] [frames]\n", argv[0] );
+        return 1;
+    }
+
+    // A faster kernel that computes something else would make the numbers below meaningless.
+    if( !SpriteBatch::kernelsMatchScalar() )
+    {
+        std::fprintf( stderr, "The %s sprite kernel disagrees with the scalar one.\n", SpriteBatch::simdPath() );
+        return 1;
+    }
+
+    constexpr uint32_t kWidth  = 1280;
+    constexpr uint32_t kHeight = 720;
+    constexpr float kDt        = 1.0f / 60.0f;
+
+    VulkanRenderer renderer;
+    if( !renderer.initHeadless( kWidth, kHeight ) )
+    {
+        std::fprintf( stderr, "Headless init failed.\n" );
+        return 1;
+    }
+
+    SpriteBatch batch;
+    if( !batch.create( renderer, sprites ) )
+    {
+        renderer.shutdown();
+        return 1;
+    }
+    batch.setSpriteSize( 4.0f, 4.0f );
+
+    // Fixed seed, so runs are comparable.
+    uint32_t seed = 12345;
+    auto random   = [&seed]( float lo, float hi ) {
+        seed = seed * 1664525u + 1013904223u;
+        return lo + ( hi - lo ) * static_cast<float>( seed >> 8 ) * ( 1.0f / 16777216.0f );
+    };
+    for( uint32_t i = 0; i < sprites; ++i )
+    {
+        const uint32_t color = 0xFF000000u | ( seed & 0x00FFFFFFu );
+        batch.add( random( 0.0f, kWidth ), random( 0.0f, kHeight ), random( -300.0f, 300.0f ), random( -300.0f, 300.0f ), color );
+    }
+
+    std::printf( "sprites: %u, frames: %u, simd: %s\n", sprites, frames, SpriteBatch::simdPath() );
+
+    // --- Physics only ---
+
+    batch.update( kDt ); // warm up caches and page in the arrays
+    double physicsMs = 0.0;
+    double bestMs    = 1e30;
+    for( uint32_t i = 0; i < frames; ++i )
+    {
+        const auto start = Clock::now();
+        batch.update( kDt );
+        const double ms = msSince( start );
+        physicsMs += ms;
+        bestMs = std::min( bestMs, ms );
+    }
+    const double physicsAvg = physicsMs / frames;
+    std::printf( "update:  avg %.3f ms, best %.3f ms, %.0f sprites/ms\n", physicsAvg, bestMs, sprites / physicsAvg );
+
+    WorkerPool pool;
+    pool.start( WorkerPool::defaultWorkerCount() );
+    if( pool.threadCount() > 1 )
+    {
+        const auto start = Clock::now();
+        for( uint32_t i = 0; i < frames; ++i )
+        {
+            batch.update( kDt, &pool );
+        }
+        const double pooledAvg = msSince( start ) / frames;
+        std::printf( "update:  avg %.3f ms on %u threads, %.0f sprites/ms\n", pooledAvg, pool.threadCount(), sprites / pooledAvg );
+    }
+
+    // --- Full frames ---
+
+    double recordMs = 0.0;
+    renderer.setRecordCallback( [&]( VkCommandBuffer cmd ) {
+        const auto start = Clock::now();
+        batch.record( cmd );
+        recordMs += msSince( start );
+    } );
+
+    double updateMs  = 0.0;
+    const auto start = Clock::now();
+    for( uint32_t i = 0; i < frames; ++i )
+    {
+        const auto updateStart = Clock::now();
+        batch.update( kDt, &pool );
+        updateMs += msSince( updateStart );
+        renderer.drawFrame();
+    }
+    renderer.waitForFrame( renderer.frameNumber() );
+    const double frameAvg = msSince( start ) / frames;
+
+    // The pipeline is built by the first record().
+    std::printf( "record:  avg %.3f ms (%s)\n", recordMs / frames, batch.drawable() ? "stream + draw call" : "stream only, no shaders" );
+    std::printf( "frame:   avg %.3f ms, %.0f sprites/ms (update %.3f ms)\n", frameAvg, sprites / frameAvg, updateMs / frames );
+
+    pool.stop();
+    batch.destroy();
+    renderer.shutdown();
+    return 0;
+}
@@ -0,0 +1,41 @@
+# Script mode (cmake -P): writes a SPIR-V binary as a constexpr uint32_t array into a C++ header.
+#
+#   -DINPUT=<file.spv> -DOUTPUT=<file.hpp> -DSYMBOL=<identifier> -DNAMESPACE=<namespace> -DSOURCE=<original file name>
+
+file(READ "${INPUT}" _hex HEX)
+string(LENGTH "${_hex}" _length)
+math(EXPR _remainder "${_length} % 8")
+if(_length EQUAL 0 OR NOT _remainder EQUAL 0)
+    message(FATAL_ERROR "${INPUT} is not a SPIR-V binary (size is not a multiple of 4 bytes)")
+endif()
+
+# SPIR-V is a stream of little-endian words; the magic number 0x07230203 comes first.
+if(NOT _hex MATCHES "^03022307")
+    message(FATAL_ERROR "${INPUT} is not a SPIR-V binary (bad magic number)")
+endif()
+
+string(REGEX REPLACE "([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])" "0x\\4\\3\\2\\1, " _words "${_hex}")
+
+# Eight words per line (CMake regexes have no {n} repetition).
+set(_word "0x[0-9a-f]+, ")
+string(REGEX REPLACE "(${_word}${_word}${_word}${_word}${_word}${_word}${_word}${_word})" "\\1\n    " _words "${_words}")
+string(REPLACE ", \n" ",\n" _words "${_words}")
+string(REGEX REPLACE "[ \n]+$" "" _words "${_words}")
+
+file(WRITE "${OUTPUT}.tmp"
+"// Generated from ${SOURCE} by vk_renderer_add_shaders(); do not edit.
+#pragma once
+
+#include <cstdint>
+
+namespace ${NAMESPACE}
+{
+inline constexpr uint32_t ${SYMBOL}[] = {
+    ${_words}
+};
+} // namespace ${NAMESPACE}
+")
+
+# Leave the header untouched when the code did not change, so dependents are not rebuilt.
+file(COPY_FILE "${OUTPUT}.tmp" "${OUTPUT}" ONLY_IF_DIFFERENT)
+file(REMOVE "${OUTPUT}.tmp")
@@ -0,0 +1,145 @@
+# Build-time shader compilation: GLSL and HLSL sources are compiled to SPIR-V, optionally optimized, and embedded
+# into generated headers as constexpr uint32_t arrays, so nothing is read from disk or compiled at startup.
+#
+#   vk_renderer_add_shaders(<target>
+#       HEADER <name.hpp>               # aggregate header including every shader of this call
+#       [NAMESPACE <ns>]                # namespace of the arrays, default "shaders"
+#       [TARGET_ENV <env>]              # glslc/glslangValidator target environment, default vulkan1.1
+#       [OPTIMIZE]                      # run spirv-opt -O over each module
+#       SOURCES <files...>)
+#
+# The shader stage comes from the extension: .vert .frag .comp .geom .tesc .tese for GLSL, and name.<stage>.hlsl
+# (e.g. sprite.vert.hlsl) for HLSL, whose entry point must be main. Each file becomes an array named after the file
+# with every non-alphanumeric character replaced by '_', e.g. sprite.vert -> shaders::sprite_vert; pass it to
+# ShaderModuleCache::get(). Headers are generated under the target's binary dir and added to its private include
+# path.
+#
+# Tools are looked up in PATH and in the Vulkan SDK ($VULKAN_SDK, ~/VulkanSDK/<version>/macOS).
+
+# Cached so the function also finds the script when called from other directories.
+set(VK_RENDERER_EMBED_SPIRV_SCRIPT "${CMAKE_CURRENT_LIST_DIR}/embed_spirv.cmake" CACHE INTERNAL "")
+
+file(GLOB _vk_renderer_sdk_bins "$ENV{HOME}/VulkanSDK/*/macOS/bin")
+set(_vk_renderer_shader_tool_hints "$ENV{VULKAN_SDK}/bin" ${_vk_renderer_sdk_bins})
+
+find_program(VK_RENDERER_GLSLC glslc HINTS ${_vk_renderer_shader_tool_hints})
+find_program(VK_RENDERER_GLSLANG glslangValidator HINTS ${_vk_renderer_shader_tool_hints})
+find_program(VK_RENDERER_DXC dxc HINTS ${_vk_renderer_shader_tool_hints})
+find_program(VK_RENDERER_SPIRV_OPT spirv-opt HINTS ${_vk_renderer_shader_tool_hints})
+
+function(vk_renderer_add_shaders TARGET_NAME)
+    cmake_parse_arguments(ARG "OPTIMIZE" "HEADER;NAMESPACE;TARGET_ENV" "SOURCES" ${ARGN})
+
+    if(NOT ARG_HEADER)
+        message(FATAL_ERROR "vk_renderer_add_shaders(${TARGET_NAME}): HEADER is required")
+    endif()
+    if(NOT ARG_NAMESPACE)
+        set(ARG_NAMESPACE "shaders")
+    endif()
+    if(NOT ARG_TARGET_ENV)
+        set(ARG_TARGET_ENV "vulkan1.1")
+    endif()
+    if(ARG_OPTIMIZE AND NOT VK_RENDERER_SPIRV_OPT)
+        message(FATAL_ERROR "vk_renderer_add_shaders(${TARGET_NAME}): OPTIMIZE needs spirv-opt, which was not found")
+    endif()
+
+    set(_out_dir "${CMAKE_CURRENT_BINARY_DIR}/${TARGET_NAME}_shaders")
+    file(MAKE_DIRECTORY "${_out_dir}")
+
+    set(_headers "")
+    set(_includes "")
+
+    foreach(_source IN LISTS ARG_SOURCES)
+        get_filename_component(_source "${_source}" ABSOLUTE)
+        get_filename_component(_name "${_source}" NAME)
+        string(REGEX REPLACE "[^A-Za-z0-9]" "_" _symbol "${_name}")
+
+        set(_spv "${_out_dir}/${_name}.spv")
+        set(_header "${_out_dir}/${_symbol}.hpp")
+
+        if(_name MATCHES "\\.(vert|frag|comp|geom|tesc|tese)\\.hlsl$")
+            # --- HLSL ---
+            if(NOT VK_RENDERER_DXC)
+                message(FATAL_ERROR "vk_renderer_add_shaders(${TARGET_NAME}): ${_name} needs dxc, which was not found")
+            endif()
+
+            set(_profile_vert "vs_6_0")
+            set(_profile_frag "ps_6_0")
+            set(_profile_comp "cs_6_0")
+            set(_profile_geom "gs_6_0")
+            set(_profile_tesc "hs_6_0")
+            set(_profile_tese "ds_6_0")
+            set(_profile "${_profile_${CMAKE_MATCH_1}}")
+
+            add_custom_command(
+                OUTPUT "${_spv}"
+                COMMAND "${VK_RENDERER_DXC}" -spirv -fspv-target-env=${ARG_TARGET_ENV} -T ${_profile} -E main -Fo "${_spv}" "${_source}"
+                DEPENDS "${_source}"
+                COMMENT "Compiling HLSL shader ${_name}"
+                VERBATIM
+            )
+        elseif(_name MATCHES "\\.(vert|frag|comp|geom|tesc|tese)$")
+            # --- GLSL ---
+            if(VK_RENDERER_GLSLC)
+                # glslc reports #include dependencies through a depfile.
+                add_custom_command(
+                    OUTPUT "${_spv}"
+                    COMMAND "${VK_RENDERER_GLSLC}" --target-env=${ARG_TARGET_ENV} -MD -MF "${_spv}.d" -o "${_spv}" "${_source}"
+                    DEPENDS "${_source}"
+                    DEPFILE "${_spv}.d"
+                    COMMENT "Compiling GLSL shader ${_name}"
+                    VERBATIM
+                )
+            elseif(VK_RENDERER_GLSLANG)
+                add_custom_command(
+                    OUTPUT "${_spv}"
+                    COMMAND "${VK_RENDERER_GLSLANG}" -V --target-env ${ARG_TARGET_ENV} -o "${_spv}" "${_source}"
+                    DEPENDS "${_source}"
+                    COMMENT "Compiling GLSL shader ${_name}"
+                    VERBATIM
+                )
+            else()
+                message(FATAL_ERROR "vk_renderer_add_shaders(${TARGET_NAME}): ${_name} needs glslc or glslangValidator, neither was found")
+            endif()
+        else()
+            message(FATAL_ERROR "vk_renderer_add_shaders(${TARGET_NAME}): cannot tell the shader stage of ${_name}")
+        endif()
+
+        set(_embedded "${_spv}")
+        if(ARG_OPTIMIZE)
+            set(_embedded "${_out_dir}/${_name}.opt.spv")
+            add_custom_command(
+                OUTPUT "${_embedded}"
+                COMMAND "${VK_RENDERER_SPIRV_OPT}" -O --target-env=${ARG_TARGET_ENV} -o "${_embedded}" "${_spv}"
+                DEPENDS "${_spv}"
+                COMMENT "Optimizing SPIR-V ${_name}"
+                VERBATIM
+            )
+        endif()
+
+        add_custom_command(
+            OUTPUT "${_header}"
+            COMMAND "${CMAKE_COMMAND}"
+                    -DINPUT=${_embedded}
+                    -DOUTPUT=${_header}
+                    -DSYMBOL=${_symbol}
+                    -DNAMESPACE=${ARG_NAMESPACE}
+                    -DSOURCE=${_name}
+                    -P "${VK_RENDERER_EMBED_SPIRV_SCRIPT}"
+            DEPENDS "${_embedded}" "${VK_RENDERER_EMBED_SPIRV_SCRIPT}"
+            COMMENT "Embedding SPIR-V ${_name}"
+            VERBATIM
+        )
+
+        list(APPEND _headers "${_header}")
+        string(APPEND _includes "#include \"${_symbol}.hpp\"\n")
+    endforeach()
+
+    file(GENERATE
+        OUTPUT "${_out_dir}/${ARG_HEADER}"
+        CONTENT "// Generated by vk_renderer_add_shaders(); do not edit.\n#pragma once\n\n${_includes}"
+    )
+
+    target_sources(${TARGET_NAME} PRIVATE ${_headers} "${_out_dir}/${ARG_HEADER}")
+    target_include_directories(${TARGET_NAME} PRIVATE "${_out_dir}")
+endfunction()
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <vk_renderer/vulkan_functions.hpp>
+#include <vulkan/vulkan.h>
+
+class DescriptorAllocator;
+
+// Hands out small integer indices that stay fixed for as long as they are held. Released indices are reused
+// most-recent first, so a table stays dense under churn.
+class IndexAllocator
+{
+  public:
+    static constexpr uint32_t kInvalid = UINT32_MAX;
+
+    void reset( uint32_t capacity );
+
+    // kInvalid when all capacity() indices are held.
+    uint32_t allocate();
+    // Releasing an index that is already free is reported and ignored.
+    void release( uint32_t index );
+
+    uint32_t capacity() const { return capacity_; }
+
+    uint32_t inUse() const { return next_ - static_cast<uint32_t>( free_.size() ); }
+
+  private:
+    std::vector<uint32_t> free_;
+    std::vector<bool> isFree_; // per index below next_, whether it is on free_
+    uint32_t next_     = 0;
+    uint32_t capacity_ = 0;
+};
+
+// Index of a resource in a BindlessTable; images and buffers are numbered separately.
+struct BindlessHandle
+{
+    uint32_t index = IndexAllocator::kInvalid;
+
+    bool valid() const { return index != IndexAllocator::kInvalid; }
+};
+
+// Every registered image and buffer in one descriptor set, so a frame binds it once and shaders select resources by
+// handle index (from push constants or instance data) instead of binding a set per draw.
+//
+// The set layout is the same in both modes, which keeps pipeline layouts and shader bindings identical:
+//   binding 0: storage buffers           (bindless: buffers[maxBuffers])
+//   binding 1: combined image samplers   (bindless: images[], variable count)
+//
+// With VK_EXT_descriptor_indexing the set is update-after-bind and partially bound: registering writes straight
+// into it, even while frames that use other entries are in flight. Without it, bind() falls back to a transient set
+// per draw holding just the requested image and buffer at element 0, and shaders must be built for that (no arrays).
+//
+// Registration is thread-safe. Releasing an index makes it available immediately, so it must only be released once
+// no in-flight frame can use it; VulkanRenderer::releaseBindlessImage() and releaseBindlessBuffer() defer it.
+class BindlessTable
+{
+  public:
+    BindlessTable() = default;
+    ~BindlessTable();
+
+    BindlessTable( const BindlessTable& )            = delete;
+    BindlessTable& operator=( const BindlessTable& ) = delete;
+
+    // limits is only read when descriptorIndexing is true; capacities are clamped to it. vk must outlive the table.
+    bool create( VkDevice device, const DeviceDispatch& vk, DescriptorAllocator& descriptors, bool descriptorIndexing,
+                 const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& limits, uint32_t maxImages, uint32_t maxBuffers );
+    void destroy();
+
+    // Whether the descriptor-indexing path is active; shaders index arrays only then.
+    bool bindless() const { return bindless_; }
+
+    VkDescriptorSetLayout layout() const { return layout_; }
+
+    // The table's set in bindless mode, VK_NULL_HANDLE otherwise.
+    VkDescriptorSet set() const { return set_; }
+
+    // Invalid handle when the table is full.
+    BindlessHandle registerImage( VkImageView view, VkSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL );
+    BindlessHandle registerBuffer( VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE );
+
+    void releaseImage( BindlessHandle handle );
+    void releaseBuffer( BindlessHandle handle );
+
+    // Binds the table at set index firstSet of pipelineLayout. In bindless mode image and buffer are ignored (the
+    // shader gets them by index) and binding once per command buffer is enough. In fallback mode each call allocates
+    // and binds a set with just those two, so call it per draw; invalid handles leave their binding unwritten.
+    void bind( VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t firstSet,
+               BindlessHandle image = {}, BindlessHandle buffer = {} );
+
+    uint32_t imageCount() const;
+    uint32_t bufferCount() const;
+
+  private:
+    VkDevice device_                  = VK_NULL_HANDLE;
+    const DeviceDispatch* vk_         = nullptr;
+    DescriptorAllocator* descriptors_ = nullptr;
+    bool bindless_                    = false;
+
+    VkDescriptorSetLayout layout_ = VK_NULL_HANDLE; // owned in bindless mode, else from the layout cache
+    VkDescriptorPool pool_        = VK_NULL_HANDLE;
+    VkDescriptorSet set_          = VK_NULL_HANDLE;
+
+    mutable std::mutex mutex_;
+    IndexAllocator imageIndices_;
+    IndexAllocator bufferIndices_;
+
+    // What each index currently refers to; the fallback path writes these into its per-draw sets.
+    std::vector<VkDescriptorImageInfo> images_;
+    std::vector<VkDescriptorBufferInfo> buffers_;
+};
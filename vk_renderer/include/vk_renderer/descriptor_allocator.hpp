@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Descriptor sets from lists of pools that grow on demand, plus a cache of descriptor set layouts.
+//
+// Pools are sized from what is actually allocated: every allocation adds its layout's descriptor counts to a running
+// demand per type, and each new pool holds twice as many sets as the last one of its list (up to a cap) in those
+// proportions. Nothing is reserved for descriptor types that are never used, and running out of a type just starts
+// another pool.
+//
+// Persistent sets live until destroy(). Transient sets are for data that changes every frame: they come from pools
+// owned by the current frame slot, which are reset in bulk when the slot comes around again. All methods are
+// thread-safe, so record jobs may allocate concurrently.
+class DescriptorAllocator
+{
+  public:
+    DescriptorAllocator() = default;
+    ~DescriptorAllocator();
+
+    DescriptorAllocator( const DescriptorAllocator& )            = delete;
+    DescriptorAllocator& operator=( const DescriptorAllocator& ) = delete;
+
+    void create( VkDevice device, uint32_t frameSlots );
+    void destroy();
+
+    // Returns a cached layout equal to info (bindings compared regardless of order), creating it on first use.
+    // Owned by the allocator. Layouts with a pNext chain are not supported and return VK_NULL_HANDLE.
+    VkDescriptorSetLayout layout( const VkDescriptorSetLayoutCreateInfo& info );
+
+    // Convenience for the common case of one binding per descriptor, numbered from 0.
+    VkDescriptorSetLayout layout( std::initializer_list<VkDescriptorType> types, VkShaderStageFlags stages );
+
+    VkDescriptorSet allocate( VkDescriptorSetLayout layout );
+
+    // Valid until the current frame slot is reused, i.e. for the frame being recorded.
+    VkDescriptorSet allocateTransient( VkDescriptorSetLayout layout );
+
+    // Called by the renderer once the slot's previous frame has finished; resets the slot's transient pools.
+    void beginFrame( uint32_t frameSlot );
+
+    // A standalone pool owned (and destroyed) by the allocator, for code that manages its own sets, such as the
+    // ImGui backend.
+    VkDescriptorPool createPool( const std::vector<VkDescriptorPoolSize>& sizes, uint32_t maxSets, VkDescriptorPoolCreateFlags flags = 0 );
+
+    uint32_t poolCount() const;
+
+    uint32_t layoutCount() const;
+
+  private:
+    // Core descriptor types, VK_DESCRIPTOR_TYPE_SAMPLER through VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT.
+    static constexpr uint32_t kTypeCount = 11;
+    using Counts                         = std::array<uint32_t, kTypeCount>;
+
+    struct PoolList
+    {
+        VkDescriptorPool current = VK_NULL_HANDLE;
+        std::vector<VkDescriptorPool> full;
+        std::vector<VkDescriptorPool> ready; // reset and unused
+        uint32_t setsPerPool = 0;
+    };
+
+    struct CachedLayout
+    {
+        VkDescriptorSetLayoutCreateFlags flags = 0;
+        std::vector<VkDescriptorSetLayoutBinding> bindings; // sorted by binding
+        std::vector<VkSampler> immutableSamplers;
+        VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    };
+
+    VkDescriptorSet allocateFrom( PoolList& list, VkDescriptorSetLayout layout );
+    VkDescriptorPool createSizedPool( uint32_t maxSets, const Counts& minimum );
+    void destroyList( PoolList& list );
+
+    VkDevice device_ = VK_NULL_HANDLE;
+
+    mutable std::mutex mutex_;
+    PoolList persistent_;
+    std::vector<PoolList> frames_;
+    uint32_t frameSlot_ = 0;
+    std::vector<VkDescriptorPool> standalone_;
+
+    // Descriptors allocated so far, per type, and the number of sets they came in.
+    std::array<uint64_t, kTypeCount> demand_{};
+    uint64_t demandSets_ = 0;
+
+    std::unordered_map<uint64_t, std::vector<CachedLayout>> layouts_; // by hash of the create info
+    std::unordered_map<VkDescriptorSetLayout, Counts> layoutCounts_;
+    uint32_t layoutCount_ = 0;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Extension names kept sorted, so lookups are a binary search instead of a re-enumeration.
+class ExtensionSet
+{
+  public:
+    void assign( const std::vector<VkExtensionProperties>& extensions );
+
+    bool contains( const char* name ) const;
+
+    size_t size() const { return names_.size(); }
+
+  private:
+    std::vector<std::string> names_;
+};
+
+// Instance extensions, enumerated on first use and then cached for the lifetime of the process. Loads the Vulkan
+// library first in dynamic builds; empty if that fails.
+const ExtensionSet& instanceExtensions();
+
+// Everything device selection and device creation need to know about one physical device, queried once.
+struct DeviceCaps
+{
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    uint32_t index                  = 0; // position in vkEnumeratePhysicalDevices order
+
+    VkPhysicalDeviceProperties properties{};
+    VkPhysicalDeviceFeatures features{};
+    VkPhysicalDeviceMemoryProperties memory{};
+    std::vector<VkQueueFamilyProperties> queueFamilies;
+    ExtensionSet extensions;
+
+    // Features behind extensions, valid only when the extension is listed.
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRendering{};
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphore{};
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexing{};
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT descriptorIndexingLimits{};
+
+    // Device/driver UUIDs; zero on Vulkan 1.0 devices.
+    VkPhysicalDeviceIDProperties ids{};
+
+    static DeviceCaps query( VkPhysicalDevice physicalDevice, uint32_t index );
+
+    bool hasExtension( const char* name ) const { return extensions.contains( name ); }
+
+    const char* name() const { return properties.deviceName; }
+
+    // Sum of the DEVICE_LOCAL heaps. On unified-memory GPUs this is (most of) system memory.
+    VkDeviceSize deviceLocalBytes() const;
+
+    // True if every feature enabled in required is supported.
+    bool supportsFeatures( const VkPhysicalDeviceFeatures& required ) const;
+};
+
+// Ranks otherwise suitable devices: discrete > integrated > virtual > CPU > other, then device-local memory.
+uint64_t scoreDevice( const DeviceCaps& caps );
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <vk_renderer/gpu_allocator.hpp>
+#include <vk_renderer/vulkan_functions.hpp>
+#include <vulkan/vulkan.h>
+
+// Pixels of one rendered frame, valid only for the duration of the capture callback.
+struct CapturedFrame
+{
+    uint64_t frame     = 0; // VulkanRenderer::frameNumber() of the captured frame
+    uint32_t width     = 0;
+    uint32_t height    = 0;
+    VkFormat format    = VK_FORMAT_UNDEFINED;
+    uint32_t rowPitch  = 0; // bytes; rows are tightly packed
+    const void* pixels = nullptr;
+};
+
+using CaptureCallback = std::function<void( const CapturedFrame& )>;
+
+// Reads rendered frames back without stalling. A capture is a copy recorded at the end of a frame's command buffer
+// into one of a small ring of persistently mapped, host-cached buffers; the callback runs once that frame has
+// completed, which the renderer notices at the start of a later frame. Slots are reused once delivered, and
+// grow to the largest image captured so far. Render thread only.
+class FrameCapture
+{
+  public:
+    FrameCapture() = default;
+    ~FrameCapture();
+
+    FrameCapture( const FrameCapture& )            = delete;
+    FrameCapture& operator=( const FrameCapture& ) = delete;
+
+    // slotCount bounds the captures in flight; one per frame in flight allows capturing every frame. vk must outlive the capture.
+    void create( VkDevice device, const DeviceDispatch& vk, GpuAllocator& allocator, uint32_t slotCount );
+    void destroy();
+
+    // Bytes per texel for the formats capture supports (8-bit and packed 32-bit color, RGBA16F), 0 otherwise.
+    static uint32_t texelSize( VkFormat format );
+
+    void request( CaptureCallback callback ) { pending_.push_back( std::move( callback ) ); }
+
+    bool hasPending() const { return !pending_.empty(); }
+
+    // Copies image into a free slot for every pending request. image is in layout (and left in it), after color
+    // attachment writes. Requests stay pending if every slot is still in flight.
+    void record( VkCommandBuffer cmd, VkImage image, VkImageLayout layout, VkExtent2D extent, VkFormat format, uint64_t frame );
+
+    // Runs the callbacks of every capture whose frame is <= completedFrames.
+    void deliver( uint64_t completedFrames );
+
+  private:
+    struct Slot
+    {
+        VkBuffer buffer           = VK_NULL_HANDLE;
+        GpuAllocation* allocation = nullptr;
+        VkDeviceSize capacity     = 0;
+        bool busy                 = false;
+        CapturedFrame info;
+        std::vector<CaptureCallback> callbacks;
+    };
+
+    VkDevice device_          = VK_NULL_HANDLE;
+    const DeviceDispatch* vk_ = nullptr;
+    GpuAllocator* allocator_  = nullptr;
+
+    std::vector<Slot> slots_;
+    std::vector<CaptureCallback> pending_;
+};
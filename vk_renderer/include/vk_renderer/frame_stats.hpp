@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Phases of VulkanRenderer::drawFrame that are timed. Gpu is the render pass duration measured with
+// timestamp queries; the others are CPU wall-clock durations. Recreate is only measured on frames that rebuilt
+// the swapchain (or headless targets).
+enum class FramePhase : uint32_t
+{
+    FenceWait,
+    Acquire,
+    Record,
+    Submit,
+    Present,
+    Recreate,
+    CpuTotal,
+    Gpu,
+    Count
+};
+
+inline constexpr size_t kFramePhaseCount = static_cast<size_t>( FramePhase::Count );
+
+const char* framePhaseName( FramePhase phase );
+
+struct FrameTiming
+{
+    uint64_t frame = 0;
+
+    // Milliseconds per phase. A negative value means the phase was not measured (e.g. Gpu on a queue
+    // without timestamp support, or Acquire/Present in headless mode).
+    std::array<double, kFramePhaseCount> ms{};
+
+    double& operator[]( FramePhase phase ) { return ms[static_cast<size_t>( phase )]; }
+
+    double operator[]( FramePhase phase ) const { return ms[static_cast<size_t>( phase )]; }
+};
+
+struct PhaseStats
+{
+    uint32_t samples = 0;
+    double minMs     = 0.0;
+    double avgMs     = 0.0;
+    double p99Ms     = 0.0;
+    double maxMs     = 0.0;
+};
+
+struct FrameStats
+{
+    uint32_t frames = 0;
+    std::array<PhaseStats, kFramePhaseCount> phases{};
+
+    const PhaseStats& operator[]( FramePhase phase ) const { return phases[static_cast<size_t>( phase )]; }
+};
+
+// Fixed-size ring of the most recent frame timings. One thread (the one calling drawFrame) pushes; any
+// thread may snapshot concurrently without locks. Each slot is guarded by a sequence counter, and readers
+// retry or skip slots that are being overwritten.
+class FrameTimingRing
+{
+  public:
+    static constexpr size_t kCapacity = 256;
+
+    void push( const FrameTiming& timing );
+
+    // Copies the valid entries, oldest first, into out (replacing its contents). Returns the entry count.
+    size_t snapshot( std::vector<FrameTiming>& out ) const;
+
+    FrameStats summarize() const;
+
+    void clear();
+
+  private:
+    struct Slot
+    {
+        std::atomic<uint64_t> seq{ 0 }; // odd while being written
+        std::atomic<uint64_t> frame{ 0 };
+        std::array<std::atomic<double>, kFramePhaseCount> ms{};
+    };
+
+    std::array<Slot, kCapacity> slots_{};
+    std::atomic<uint64_t> head_{ 0 }; // total number of pushes
+};
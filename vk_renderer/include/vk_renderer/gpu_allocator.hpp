@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <vk_renderer/device_caps.hpp>
+#include <vulkan/vulkan.h>
+
+struct GpuMemoryBlock;
+
+// Where an allocation should live. Each usage maps to required and preferred memory properties and falls back
+// to the required set alone when no memory type has both.
+enum class GpuMemoryUsage
+{
+    GpuOnly,  // DEVICE_LOCAL. Render targets, static vertex/index buffers, sampled images.
+    CpuToGpu, // HOST_VISIBLE | HOST_COHERENT, preferably DEVICE_LOCAL (unified memory on Apple GPUs). Persistently mapped.
+    GpuToCpu, // HOST_VISIBLE, preferably HOST_CACHED. Readback. Persistently mapped.
+};
+
+// Linear resources (buffers, linear-tiled images) and optimal-tiled images never share a block, which keeps
+// neighbouring allocations clear of bufferImageGranularity without padding every allocation.
+enum class GpuResourceKind
+{
+    Linear,
+    Optimal,
+};
+
+// A range of device memory handed out by GpuAllocator. The object is owned by the allocator and keeps its
+// address until freed; defragment() updates memory/offset/mapped in place when it moves the allocation.
+struct GpuAllocation
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset   = 0;
+    VkDeviceSize size     = 0;
+    void* mapped          = nullptr; // host pointer to offset for mapped allocations, otherwise null
+    uint32_t memoryType   = 0;
+    bool dedicated        = false; // owns its VkDeviceMemory
+
+  private:
+    friend class GpuAllocator;
+
+    GpuMemoryBlock* block_  = nullptr; // null for dedicated allocations
+    size_t slot_            = 0;       // index in block_->allocations, or in the allocator's dedicated list
+    VkDeviceSize alignment_ = 1;
+};
+
+struct GpuAllocatorStats
+{
+    uint32_t deviceMemoryCount = 0; // live vkAllocateMemory allocations (blocks + dedicated)
+    uint32_t maxMemoryCount    = 0; // VkPhysicalDeviceLimits::maxMemoryAllocationCount
+    uint32_t blockCount        = 0;
+    uint32_t dedicatedCount    = 0;
+    uint32_t allocationCount   = 0; // live sub-allocations and dedicated allocations
+    VkDeviceSize reservedBytes = 0; // device memory held by blocks and dedicated allocations
+    VkDeviceSize usedBytes     = 0; // of which handed out
+    VkDeviceSize largestFree   = 0; // largest free range in any block
+};
+
+// Block-based sub-allocator: every memory type gets pools of large VkDeviceMemory blocks (one pool per
+// GpuResourceKind), and resources are placed inside them, so thousands of resources cost a handful of driver
+// allocations. Within a block, free ranges are indexed by offset (for coalescing on free) and by size (for a
+// best-fit search), so both allocate and free are O(log n) in the number of free ranges.
+//
+// Allocations larger than half a block, or that the driver prefers dedicated (VkMemoryDedicatedRequirements),
+// get their own VkDeviceMemory. All functions are thread-safe.
+class GpuAllocator
+{
+  public:
+    // Called by defragment() for every allocation it wants to move. The callback must rebind the resource to
+    // (memory, offset) and copy its contents, completing the copy before it returns, because the old range is
+    // reused as soon as it returns true. Returning false leaves the allocation where it is. Must not call back
+    // into the allocator.
+    using MoveCallback = std::function<bool( const GpuAllocation& from, VkDeviceMemory memory, VkDeviceSize offset )>;
+
+    GpuAllocator();
+    ~GpuAllocator();
+
+    GpuAllocator( const GpuAllocator& )            = delete;
+    GpuAllocator& operator=( const GpuAllocator& ) = delete;
+
+    // Memory types and limits come from caps. blockSize 0 picks 64 MiB, or an eighth of the heap for heaps of 1 GiB and less.
+    void create( const DeviceCaps& caps, VkDevice device, VkDeviceSize blockSize = 0 );
+    void destroy();
+
+    // Returns null when memory is exhausted or no memory type in req.memoryTypeBits satisfies usage. Host-visible
+    // memory is always mapped.
+    GpuAllocation* allocate( const VkMemoryRequirements& req, GpuMemoryUsage usage, GpuResourceKind kind, bool dedicated = false );
+    void free( GpuAllocation* allocation );
+
+    // Create the resource, allocate and bind its memory. Return VK_NULL_HANDLE on failure.
+    VkBuffer createBuffer( const VkBufferCreateInfo& info, GpuMemoryUsage usage, GpuAllocation** allocation );
+    VkImage createImage( const VkImageCreateInfo& info, GpuMemoryUsage usage, GpuAllocation** allocation, bool dedicated = false );
+    void destroyBuffer( VkBuffer buffer, GpuAllocation* allocation );
+    void destroyImage( VkImage image, GpuAllocation* allocation );
+
+    // Only needed for memory types without HOST_COHERENT (GpuToCpu may pick one); no-ops otherwise.
+    void flush( const GpuAllocation* allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE );
+    void invalidate( const GpuAllocation* allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE );
+
+    // Moves allocations out of the least occupied blocks into free space of fuller ones and releases blocks
+    // that end up empty. Never allocates new blocks. Returns the number of allocations moved.
+    uint32_t defragment( const MoveCallback& move, uint32_t maxMoves = UINT32_MAX );
+
+    GpuAllocatorStats stats() const;
+
+  private:
+    using Pool = std::vector<std::unique_ptr<GpuMemoryBlock>>;
+
+    // dedicatedInfo names the resource when the memory is for exactly one buffer or image; it is chained
+    // only if the allocation ends up dedicated.
+    GpuAllocation* allocateMemory( const VkMemoryRequirements& req, GpuMemoryUsage usage, GpuResourceKind kind, bool dedicated,
+                                   const VkMemoryDedicatedAllocateInfo* dedicatedInfo );
+    GpuAllocation* allocateDedicated( VkDeviceSize size, uint32_t typeIndex, const VkMemoryDedicatedAllocateInfo* dedicatedInfo );
+    GpuAllocation* allocateFromPool( const VkMemoryRequirements& req, uint32_t typeIndex, GpuResourceKind kind );
+
+    bool findMemoryType( uint32_t typeBits, GpuMemoryUsage usage, uint32_t& typeIndex ) const;
+    VkDeviceSize blockSizeFor( uint32_t typeIndex ) const;
+    Pool& poolFor( uint32_t typeIndex, GpuResourceKind kind );
+
+    GpuMemoryBlock* createBlock( Pool& pool, VkDeviceSize minSize, uint32_t typeIndex, GpuResourceKind kind );
+    void releaseEmptyBlocks( Pool& pool, bool keepSpare );
+
+    GpuAllocation* attach( std::unique_ptr<GpuAllocation> allocation, GpuMemoryBlock* block, VkDeviceSize offset );
+    std::unique_ptr<GpuAllocation> detach( GpuAllocation* allocation );
+    bool mappedRange( const GpuAllocation* allocation, VkDeviceSize offset, VkDeviceSize size, VkMappedMemoryRange& range ) const;
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProps_{};
+    VkDeviceSize blockSize_       = 0;
+    VkDeviceSize nonCoherentAtom_ = 1;
+    uint32_t maxMemoryCount_      = 0;
+
+    mutable std::mutex mutex_;
+    std::vector<Pool> pools_; // memoryType * 2 + kind
+    std::vector<std::unique_ptr<GpuAllocation>> dedicated_;
+};
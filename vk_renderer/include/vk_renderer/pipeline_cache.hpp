@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vk_renderer/device_caps.hpp>
+#include <vulkan/vulkan.h>
+
+// VkPipelineCache persisted to disk between runs. Pipeline compilation is expensive on MoltenVK (every
+// pipeline goes through SPIR-V -> MSL conversion), so a warm cache cuts cold start considerably.
+//
+// The file stores its own header ahead of the driver blob: vendor/device IDs, driver version, the
+// pipeline cache UUID and the device/driver UUIDs, plus the blob size and hash. A file that does not match
+// the current device or driver, or is truncated or corrupt, is ignored and the cache starts empty.
+// Saves write a temporary file and rename it over the old one, so a crash never leaves a half-written cache.
+class PipelineCache
+{
+  public:
+    PipelineCache() = default;
+    ~PipelineCache();
+
+    PipelineCache( const PipelineCache& )            = delete;
+    PipelineCache& operator=( const PipelineCache& ) = delete;
+
+    // The file header is built from caps. path may be empty, in which case the cache lives in memory only.
+    void create( const DeviceCaps& caps, VkDevice device, std::string path );
+    void destroy();
+
+    // Writes the cache to disk if its contents changed since it was loaded or last saved. Returns false on I/O failure, or
+    // when pipelines created concurrently kept growing the cache faster than it could be read back.
+    bool save();
+
+    VkPipelineCache handle() const { return cache_; }
+
+    // Size of the driver blob that was loaded from disk (0 on a cold start).
+    size_t loadedBytes() const { return loadedBytes_; }
+
+  private:
+    struct FileHeader;
+
+    void fillHeader( FileHeader& header ) const;
+
+    VkPhysicalDeviceProperties properties_{};
+    VkPhysicalDeviceIDProperties ids_{};
+    VkDevice device_       = VK_NULL_HANDLE;
+    VkPipelineCache cache_ = VK_NULL_HANDLE;
+    std::string path_;
+    size_t loadedBytes_ = 0;
+    size_t savedBytes_  = 0;
+    uint64_t savedHash_ = 0; // of the blob on disk, with savedBytes_
+};
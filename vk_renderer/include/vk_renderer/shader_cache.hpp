@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// VkShaderModules keyed by the content of their SPIR-V, so code that asks for the same shader repeatedly (several
+// pipelines sharing a vertex shader, or a pipeline rebuilt after a resize) creates the module only once. Meant for
+// the constexpr arrays generated by vk_renderer_add_shaders() in CMake; modules are owned by the cache and live
+// until destroy(). Thread-safe.
+class ShaderModuleCache
+{
+  public:
+    ShaderModuleCache() = default;
+    ~ShaderModuleCache();
+
+    ShaderModuleCache( const ShaderModuleCache& )            = delete;
+    ShaderModuleCache& operator=( const ShaderModuleCache& ) = delete;
+
+    void create( VkDevice device );
+    void destroy();
+
+    // VK_NULL_HANDLE when sizeBytes is not a non-zero multiple of 4 or module creation fails.
+    VkShaderModule get( const uint32_t* code, size_t sizeBytes );
+
+    template <size_t N>
+    VkShaderModule get( const uint32_t ( &code )[N] )
+    {
+        return get( code, sizeof( code ) );
+    }
+
+    uint32_t size() const;
+
+  private:
+    struct Entry
+    {
+        std::vector<uint32_t> code; // compared on lookup, so a hash collision cannot return the wrong module
+        VkShaderModule module = VK_NULL_HANDLE;
+    };
+
+    VkDevice device_ = VK_NULL_HANDLE;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<uint64_t, std::vector<Entry>> modules_; // by hash of the code
+    uint32_t count_ = 0;
+};
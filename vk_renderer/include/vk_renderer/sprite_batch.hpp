@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+class VulkanRenderer;
+class WorkerPool;
+struct GpuAllocation;
+
+// Many identical sprites bouncing inside a rectangle, drawn with one instanced draw call.
+//
+// State is kept as structure of arrays (x, y, vx, vy, color), so update() runs the same kernel over each axis with
+// SIMD: AVX or SSE2 on x86 (AVX picked at runtime), NEON on ARM, scalar elsewhere and for the tail. record() streams
+// the positions into the current frame slot's region of a persistently mapped instance buffer, which the vertex
+// shader reads as three per-instance attributes (x, y and color each from their own array), and draws every sprite
+// as a 4-vertex strip in a single vkCmdDraw.
+//
+// Drawing needs the sprite shaders embedded at build time (vk_renderer_add_shaders() with a GLSL compiler present);
+// without them drawable() stays false and record() only streams the instance data. Render thread only, except for the
+// host-side state, which belongs to whoever calls update().
+class SpriteBatch
+{
+  public:
+    static constexpr uint32_t kInvalid = UINT32_MAX;
+
+    SpriteBatch() = default;
+    ~SpriteBatch();
+
+    SpriteBatch( const SpriteBatch& )            = delete;
+    SpriteBatch& operator=( const SpriteBatch& ) = delete;
+
+    // Call after renderer init(). capacity is fixed for the lifetime of the batch. The bounds start as the
+    // renderer's extent.
+    bool create( VulkanRenderer& renderer, uint32_t capacity );
+
+    // GPU objects go through the renderer's deferDestroy(), so call this before the renderer's shutdown().
+    void destroy();
+
+    // Position is the sprite centre in pixels from the top-left of the target; velocity is in pixels per second.
+    // color is packed RGBA8 (red in the lowest byte). Returns the sprite's index, or kInvalid when full.
+    uint32_t add( float x, float y, float vx, float vy, uint32_t color );
+    void clear();
+
+    // Size of every sprite in pixels; default 16x16.
+    void setSpriteSize( float width, float height );
+
+    // Area the sprites bounce in, from the top-left of the target; sprites stay fully inside it.
+    void setBounds( float width, float height );
+
+    // Moves every sprite by dt seconds, reflecting off the bounds. With a pool, chunks of sprites are updated in
+    // parallel on it (the bounce is memory-bound, so this pays off on large batches).
+    void update( float dt, WorkerPool* pool = nullptr );
+
+    // Call once per frame from the record callback (or a record job), inside the frame's rendering.
+    void record( VkCommandBuffer cmd );
+
+    // Known after the first record().
+    bool drawable() const { return pipeline_ != VK_NULL_HANDLE; }
+
+    uint32_t size() const { return count_; }
+
+    uint32_t capacity() const { return capacity_; }
+
+    const float* x() const { return x_.data(); }
+
+    const float* y() const { return y_.data(); }
+
+    // Kernel update() uses on this machine: "avx", "sse2", "neon" or "scalar".
+    static const char* simdPath();
+
+    // Runs every SIMD kernel this machine supports and the scalar one over the same sprites and compares the results
+    // bit for bit. For benchmarks and tests.
+    static bool kernelsMatchScalar();
+
+  private:
+    bool createPipeline();
+    void destroyPipeline();
+
+    VulkanRenderer* renderer_ = nullptr;
+    VkDevice device_          = VK_NULL_HANDLE;
+
+    // Per frame slot: x[capacity], y[capacity], color[capacity].
+    VkBuffer instanceBuffer_       = VK_NULL_HANDLE;
+    GpuAllocation* instanceMemory_ = nullptr;
+    VkDeviceSize slotStride_       = 0;
+
+    VkPipelineLayout pipelineLayout_ = VK_NULL_HANDLE;
+    VkPipeline pipeline_             = VK_NULL_HANDLE;
+    VkFormat pipelineFormat_         = VK_FORMAT_UNDEFINED;
+    bool pipelineBuilt_              = false; // built (or attempted) for pipelineFormat_
+
+    std::vector<float> x_;
+    std::vector<float> y_;
+    std::vector<float> vx_;
+    std::vector<float> vy_;
+    std::vector<uint32_t> color_;
+    uint32_t count_    = 0;
+    uint32_t capacity_ = 0;
+
+    // Colors only change on add() and clear(), so each slot copies them only when its version is stale.
+    uint64_t colorVersion_ = 0;
+    std::vector<uint64_t> slotColorVersion_;
+
+    float halfWidth_    = 8.0f;
+    float halfHeight_   = 8.0f;
+    float boundsWidth_  = 0.0f;
+    float boundsHeight_ = 0.0f;
+};
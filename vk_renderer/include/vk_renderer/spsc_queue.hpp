@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread. Each side owns one index and
+// only reads the other's; a cached copy of the other index keeps the shared cache lines from bouncing on every call.
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert( Capacity >= 2 && ( Capacity & ( Capacity - 1 ) ) == 0, "Capacity must be a power of two" );
+
+  public:
+    // Producer only. False when full; value is left untouched then.
+    bool tryPush( T&& value )
+    {
+        const size_t head = head_.load( std::memory_order_relaxed );
+        if( head - cachedTail_ == Capacity )
+        {
+            cachedTail_ = tail_.load( std::memory_order_acquire );
+            if( head - cachedTail_ == Capacity )
+                return false;
+        }
+
+        slots_[head & ( Capacity - 1 )] = std::move( value );
+        head_.store( head + 1, std::memory_order_release );
+        return true;
+    }
+
+    // Consumer only. False when empty.
+    bool tryPop( T& out )
+    {
+        const size_t tail = tail_.load( std::memory_order_relaxed );
+        if( tail == cachedHead_ )
+        {
+            cachedHead_ = head_.load( std::memory_order_acquire );
+            if( tail == cachedHead_ )
+                return false;
+        }
+
+        T& slot = slots_[tail & ( Capacity - 1 )];
+        out     = std::move( slot );
+        slot    = T{}; // release what the entry held now, not when the slot is next overwritten
+        tail_.store( tail + 1, std::memory_order_release );
+        return true;
+    }
+
+    // Either side; exact only when the other side is idle.
+    bool empty() const { return head_.load( std::memory_order_acquire ) == tail_.load( std::memory_order_acquire ); }
+
+  private:
+    static constexpr size_t kCacheLine = 64;
+
+    alignas( kCacheLine ) std::atomic<size_t> head_{ 0 }; // written by the producer
+    size_t cachedTail_ = 0;
+
+    alignas( kCacheLine ) std::atomic<size_t> tail_{ 0 }; // written by the consumer
+    size_t cachedHead_ = 0;
+
+    alignas( kCacheLine ) std::array<T, Capacity> slots_{};
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <vk_renderer/gpu_allocator.hpp>
+#include <vk_renderer/vulkan_functions.hpp>
+#include <vulkan/vulkan.h>
+
+// Identifies the batch an upload went into. Tickets increase monotonically; 0 means the upload was not queued.
+using UploadTicket = uint64_t;
+
+// Streams buffer and image data to the GPU without stalling the frame loop. Data is copied into a persistently
+// mapped staging ring, and copies are recorded into the current batch, which is submitted as a whole (normally
+// once per frame by VulkanRenderer::drawFrame()). Batches run on the transfer queue, which is a dedicated transfer
+// family when the device has one; resources then get a queue family ownership release there and the matching
+// acquire on the graphics queue.
+//
+// Completion is tracked with a fence per batch that is only ever polled. A finished batch is handed to the next
+// frame: its acquire barriers are recorded ahead of the render pass and the frame waits on the batch's
+// (already signaled) semaphore, so from that frame on the data is visible to rendering.
+class UploadQueue
+{
+  public:
+    UploadQueue() = default;
+    ~UploadQueue();
+
+    UploadQueue( const UploadQueue& )            = delete;
+    UploadQueue& operator=( const UploadQueue& ) = delete;
+
+    // transferFamily may equal graphicsFamily (and transferQueue may be the graphics queue itself), in which case
+    // no ownership transfer is recorded. Every call goes through vk, which must outlive the queue.
+    //
+    // Without frameSemaphores, for frames submitted by someone else who cannot wait on our semaphores, transferQueue
+    // must be the queue the frames go to: batches are then ordered before the frame by submission order alone, and
+    // acquire() records a memory barrier in place of the semaphore wait.
+    void create( VkDevice device, const DeviceDispatch& vk, GpuAllocator& allocator, VkQueue transferQueue, uint32_t transferFamily,
+                 uint32_t graphicsFamily, VkDeviceSize ringSize, bool frameSemaphores = true );
+    void destroy();
+
+    // Runs on the uploading thread after every queued upload, outside the queue's lock, so whoever submits batches can
+    // wake up for it. Set it before any thread uploads.
+    void setQueuedCallback( std::function<void()> callback ) { queuedCallback_ = std::move( callback ); }
+
+    // Thread-safe. Return 0 if the ring is currently too full (retry on a later frame) or size exceeds the ring.
+    // The destination must not be in use by the GPU until the ticket completes.
+    UploadTicket uploadBuffer( VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size );
+
+    // Uploads one whole mip level, layers [0, layerCount), as tightly packed texels, and leaves it in finalLayout.
+    // Whole levels keep the copy valid on transfer families with coarse minImageTransferGranularity.
+    UploadTicket uploadImage( VkImage dst, VkExtent3D extent, uint32_t mipLevel, uint32_t layerCount, const void* data, VkDeviceSize size,
+                              VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                              VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT );
+
+    // True once the data may be used by command buffers recorded from now on. Lock-free.
+    bool isComplete( UploadTicket ticket ) const { return ticket != 0 && ticket <= completed_.load( std::memory_order_acquire ); }
+
+    // True while a batch is open or a submitted one has not been handed to a frame by acquire() yet, i.e. while
+    // some ticket needs further drawFrame() calls to complete.
+    bool hasPending() const;
+
+    // Render thread only. Submits the current batch, if any.
+    void submit();
+
+    // Render thread only, once per frame, into the frame's primary command buffer before any rendering. Hands every
+    // batch that finished since the last call to this frame: records their acquire barriers and appends their
+    // semaphores (if any), which the frame's submit must wait on. frame is the number the submit will get; batches waited
+    // on by frames up to completedFrames are recycled.
+    void acquire( VkCommandBuffer cmd, uint64_t frame, uint64_t completedFrames, std::vector<VkSemaphore>& waitSemaphores );
+
+    bool ownershipTransfer() const { return transferFamily_ != graphicsFamily_; }
+
+    VkDeviceSize ringSize() const { return ringSize_; }
+
+  private:
+    struct Batch
+    {
+        VkCommandPool pool    = VK_NULL_HANDLE;
+        VkCommandBuffer cmd   = VK_NULL_HANDLE;
+        VkFence fence         = VK_NULL_HANDLE;
+        VkSemaphore semaphore = VK_NULL_HANDLE;
+        UploadTicket ticket   = 0;
+        uint64_t ringEnd      = 0; // ring head when submitted; the tail may advance here once the batch finishes
+        uint64_t waitFrame    = 0; // frame whose submit waits on semaphore
+
+        std::vector<VkBufferMemoryBarrier> bufferAcquires;
+        std::vector<VkImageMemoryBarrier> imageAcquires;
+    };
+
+    // The upload*() bodies, under the lock; queued() then runs the callback outside it.
+    UploadTicket queueBuffer( VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size );
+    UploadTicket queueImage( VkImage dst, VkExtent3D extent, uint32_t mipLevel, uint32_t layerCount, const void* data, VkDeviceSize size,
+                             VkImageLayout finalLayout, VkImageAspectFlags aspect );
+    UploadTicket queued( UploadTicket ticket );
+
+    bool reserve( VkDeviceSize size, VkDeviceSize& offset );
+    Batch& openBatch();
+    void destroyBatch( Batch& batch );
+
+    VkDevice device_          = VK_NULL_HANDLE;
+    const DeviceDispatch* vk_ = nullptr;
+    GpuAllocator* allocator_  = nullptr;
+    VkQueue transferQueue_    = VK_NULL_HANDLE;
+    uint32_t transferFamily_  = 0;
+    uint32_t graphicsFamily_  = 0;
+    bool frameSemaphores_     = true;
+    std::function<void()> queuedCallback_;
+
+    VkBuffer ring_            = VK_NULL_HANDLE;
+    GpuAllocation* ringAlloc_ = nullptr;
+    VkDeviceSize ringSize_    = 0;
+    uint64_t head_            = 0; // monotonic byte positions; the live region is [tail_, head_)
+    uint64_t tail_            = 0;
+    UploadTicket nextTicket_  = 1;
+    std::atomic<UploadTicket> completed_{ 0 };
+
+    mutable std::mutex mutex_;
+    std::unique_ptr<Batch> open_;
+    std::deque<std::unique_ptr<Batch>> inFlight_; // submitted, in submission order
+    std::deque<std::unique_ptr<Batch>> retiring_; // finished, waiting for the frame that waits on them
+    std::vector<std::unique_ptr<Batch>> free_;
+
+    std::vector<VkBufferMemoryBarrier> bufferBarriers_;
+    std::vector<VkImageMemoryBarrier> imageBarriers_;
+};
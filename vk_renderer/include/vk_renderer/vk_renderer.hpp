@@ -1,7 +1,28 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
 #include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vk_renderer/bindless_table.hpp>
+#include <vk_renderer/descriptor_allocator.hpp>
+#include <vk_renderer/device_caps.hpp>
+#include <vk_renderer/frame_capture.hpp>
+#include <vk_renderer/frame_stats.hpp>
+#include <vk_renderer/gpu_allocator.hpp>
+#include <vk_renderer/pipeline_cache.hpp>
+#include <vk_renderer/shader_cache.hpp>
+#include <vk_renderer/spsc_queue.hpp>
+#include <vk_renderer/upload_queue.hpp>
+#include <vk_renderer/vulkan_functions.hpp>
+#include <vk_renderer/worker_pool.hpp>
 #include <vulkan/vulkan.h>
 
 class VulkanRenderer
@@ -9,7 +30,59 @@ class VulkanRenderer
   public:
     using RecordCallback = std::function<void( VkCommandBuffer )>;
 
-    VulkanRenderer() = default;
+    // How frames are paced against the display. Each policy maps to an ordered list of present modes and
+    // falls back to the next one (ultimately FIFO, which is always available) when the surface lacks it.
+    enum class PresentPolicy
+    {
+        PowerSaving,   // FIFO: vsync-capped, never tears, lowest power. Default.
+        LowLatency,    // MAILBOX -> FIFO_RELAXED -> FIFO: newest frame wins at vblank, no tearing.
+        Uncapped,      // IMMEDIATE -> MAILBOX -> FIFO: no cap at all, for throughput benchmarks; may tear.
+        AdaptiveVsync, // FIFO_RELAXED -> FIFO: vsync, but late frames tear instead of waiting a full interval.
+    };
+
+    // How resize() requests turn into swapchain recreation. A drag-resize delivers a new size nearly every frame,
+    // and rebuilding on each of them is what makes live resizing slow; these settings trade a briefly stretched
+    // image for far fewer rebuilds.
+    struct ResizePolicy
+    {
+        // Recreate only once no resize has arrived for this long, so a burst collapses into one rebuild.
+        uint32_t settleMs = 100;
+
+        // Minimum time between two recreations, even if the size keeps changing.
+        uint32_t minIntervalMs = 50;
+
+        // While waiting, keep presenting to the old swapchain, which the presentation engine scales to the
+        // surface (CAMetalLayer stretches it). Otherwise, and whenever the old swapchain is out of date, frames are
+        // skipped until it is recreated: drawFrame() then sleeps until minIntervalMs allows the rebuild.
+        bool presentStale = true;
+    };
+
+    // Counters for the resize policy. recreateMs is the cost of the most recent rebuild; the distribution is in
+    // frameStats() under FramePhase::Recreate.
+    struct ResizeStats
+    {
+        uint64_t resizeEvents  = 0; // resize() calls that changed the size, plus suboptimal/out-of-date reports
+        uint64_t recreations   = 0;
+        uint64_t staleFrames   = 0; // frames presented to a swapchain already due for recreation
+        uint64_t skippedFrames = 0; // frames dropped because nothing current could be presented to
+        double recreateMs      = 0.0;
+    };
+
+    // Vulkan objects of a host that owns the device and the frame loop (e.g. Qt Quick), for initExternal().
+    struct ExternalDevice
+    {
+        VkInstance instance             = VK_NULL_HANDLE;
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+        VkDevice device                 = VK_NULL_HANDLE;
+        VkQueue queue                   = VK_NULL_HANDLE; // the host's graphics queue
+        uint32_t queueFamilyIndex       = 0;
+        uint32_t framesInFlight         = 2; // the host's, at most kMaxFramesInFlight
+    };
+
+    // Upper bound for setFramesInFlight(). Per-frame resources are stored in a fixed array of this size.
+    static constexpr uint32_t kMaxFramesInFlight = 3;
+
+    VulkanRenderer();
     ~VulkanRenderer();
 
     // nativeLayer is expected to be a CAMetalLayer* (iOS/macOS) but passed as void*
@@ -20,44 +93,346 @@ class VulkanRenderer
     // This is compiled only if VK_RENDERER_USE_GLFW is defined.
     bool initGlfw( void* glfwWindow );
 
+    // Offscreen mode: renders into renderer-owned images instead of a swapchain, so no window system or
+    // surface extension is needed. Works with software ICDs (lavapipe, SwiftShader) on GPU-less machines.
+    // After each frame the target is left in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL.
+    bool initHeadless( uint32_t width, uint32_t height, VkFormat format = VK_FORMAT_R8G8B8A8_UNORM );
+
+    // External mode: renders into a host's frames on the host's device instead of owning a device and a target.
+    // The host keeps acquiring, submitting and presenting; each of its frames calls beginExternalFrame() before its
+    // render pass and recordExternalFrame() inside it, on the thread that records the frame. drawFrame(), resize()
+    // and the render thread are not used, and captures are unsupported. Everything on the device is submitted to
+    // the host's queue (uploads included, ordered before the frame by submission order), so it must not be used
+    // concurrently with these calls. The instance and device must be Vulkan 1.1 and outlive shutdown(), which
+    // waits for the device to idle but destroys neither.
+    bool initExternal( const ExternalDevice& host );
+
+    bool isExternal() const { return external_; }
+
+    // External mode, outside any render pass of cmd. frameSlot is the host's frame slot, which the host reuses only
+    // after the frame that last used it has finished. Submits pending uploads, makes finished ones visible to cmd,
+    // and records the queued compute jobs into cmd, followed by a barrier to their dstStages.
+    void beginExternalFrame( VkCommandBuffer cmd, uint32_t frameSlot );
+
+    // External mode, inside the host's render pass on cmd; renderPass() and colorFormat() return renderPass and
+    // colorFormat for the duration, for pipelines. colorFormat may be VK_FORMAT_UNDEFINED if the host does not expose
+    // it (pipelines only need a compatible render pass). Runs the record jobs, in order on this thread, then the
+    // record callback, and ends the frame.
+    void recordExternalFrame( VkCommandBuffer cmd, VkRenderPass renderPass, VkFormat colorFormat, VkExtent2D extent );
+
+    // Cheap: records the size, which is applied according to resizePolicy(). Repeated calls with the same size,
+    // including the current one, are coalesced. With a render thread running, calls from other threads are posted.
     void resize( uint32_t width, uint32_t height );
     void drawFrame();
     void shutdown();
 
+    // Render thread mode: a dedicated thread owns drawFrame() (acquire, record, submit, present), so hitches in app
+    // event processing and in rendering no longer delay each other. It draws back to back (paced by presentation),
+    // or per renderOnDemand(), sleeping while there is nothing to do. Everything documented as render thread only
+    // then belongs to that thread: the app thread reaches it through post(), resize() and invalidate(), which go
+    // through a lock-free single-producer queue. Only the thread that started it may post (or call anything that
+    // posts, shutdown() included); other threads, record jobs among them, abort. Works headless.
+    bool startRenderThread();
+
+    // Runs what was posted so far, then joins. shutdown() calls it.
+    void stopRenderThread();
+
+    bool renderThreadRunning() const { return renderThreadActive_.load( std::memory_order_relaxed ); }
+
+    // Runs fn on the render thread before its next frame, in posting order; for per-frame data (e.g. a snapshot of
+    // app state for the record callbacks) and render-thread-only calls. Runs fn right away when no render thread
+    // is running. Blocks only while the queue is full.
+    void post( std::function<void()> fn );
+
+    // With a render thread running, this and the record job calls below are posted, so they take effect from the
+    // next frame it starts.
     void setRecordCallback( RecordCallback cb );
 
+    // Record jobs are recorded in parallel on a worker pool, each into its own secondary command buffer, and
+    // executed in registration order. While any job is registered the render pass contents are secondary
+    // command buffers, so the record callback is recorded into one as well and executed after the jobs.
+    // Secondary buffers inherit no dynamic state: every job sets its own viewport and scissor. Jobs run
+    // concurrently and must not touch shared mutable state. Returns an id for removeRecordJob().
+    uint32_t addRecordJob( RecordCallback job );
+    void removeRecordJob( uint32_t id );
+    void clearRecordJobs();
+
+    // Queues compute work for the next frame and returns its number (frameNumber() + 1). That drawFrame() records
+    // every queued job, in order, into one command buffer on computeQueue() and submits it ahead of the frame's
+    // graphics, which waits on it only at dstStages: the dispatches overlap the previous frame's rendering and the
+    // graphics work that does not consume them. Render thread only: called from another thread while a render thread
+    // runs, it queues nothing and returns 0.
+    //
+    // The previous frames may still be reading what the GPU wrote before, so per-frame outputs need a copy per frame
+    // slot (currentFrameIndex()). When computeQueueFamilyIndex() differs from graphicsQueueFamilyIndex(), resources
+    // used on both queues need VK_SHARING_MODE_CONCURRENT or explicit ownership transfers.
+    uint64_t submitCompute( RecordCallback record, VkPipelineStageFlags dstStages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                                                                                   VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                                                                                   VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                                                                   VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT );
+
+    // Worker threads for record jobs, besides the thread calling drawFrame(), which records too. Must be
+    // called before init(); defaults to one less than the number of hardware threads. The threads and their command
+    // pools are only created by the first frame that has record jobs.
+    void setRecordThreadCount( uint32_t workers );
+
+    // May be called at any time; with a render thread running, the change is posted. Headless targets ignore it and
+    // are recreated on the next frame, since nothing presents them.
+    void setResizePolicy( const ResizePolicy& policy );
+
+    // Render thread only.
+    const ResizePolicy& resizePolicy() const { return resizePolicy_; }
+
+    // Render thread only.
+    const ResizeStats& resizeStats() const { return resizeStats_; }
+
+    // Render on demand: drawFrame() only renders when something asked for a frame and otherwise returns after
+    // polling for finished frames (so deferred destruction and captures still complete), with no acquire, record,
+    // submit or present. The last presented image stays on screen. Off by default (every drawFrame() renders).
+    // May be called at any time, from any thread.
+    void setRenderOnDemand( bool enabled );
+
+    bool renderOnDemand() const { return renderOnDemand_.load( std::memory_order_relaxed ); }
+
+    // Asks for at least frames more rendered frames. Thread-safe, so input handlers, loaders and worker threads may
+    // call it. Resizes, present policy changes, record callback or job changes, captures, compute jobs and uploads
+    // waiting for a frame count as requests by themselves.
+    void invalidate( uint32_t frames = 1 );
+
+    // Whether the next drawFrame() would render. Render thread only; lets a loop sleep (e.g. glfwWaitEvents, or
+    // pausing a display link) instead of calling drawFrame() for nothing. Frames still in flight
+    // (completedFrameNumber() < frameNumber()) need idle drawFrame() calls to run their deferred destruction and
+    // capture callbacks.
+    bool needsFrame() const;
+
+    // drawFrame() calls that rendered nothing because of render on demand. Render thread only.
+    uint64_t idleFrameCount() const { return idleFrames_; }
+
+    // Number of frames the CPU may record ahead of the GPU, clamped to [1, kMaxFramesInFlight].
+    // Must be called before init(); the default of 2 lets CPU recording overlap GPU execution.
+    void setFramesInFlight( uint32_t count );
+
+    // Size of the persistently mapped staging ring used by uploads(). Must be called before init(); default 32 MiB.
+    // A single upload can be at most this large.
+    void setUploadRingSize( VkDeviceSize bytes );
+
+    // Opt in to VK_KHR_dynamic_rendering. Must be called before init(). Where the device supports it, frames render
+    // straight into the target image views with explicit layout barriers; no VkRenderPass or VkFramebuffer exists,
+    // so swapchain recreation only rebuilds image views. renderPass() is then VK_NULL_HANDLE and pipelines (ImGui's
+    // included, via UseDynamicRendering) are created with VkPipelineRenderingCreateInfo for colorFormat().
+    // Off by default: the render pass path is what ImGui setups built around renderPass() expect.
+    void setDynamicRenderingEnabled( bool enabled );
+
+    // Whether the dynamic rendering path is active (requested and supported).
+    bool dynamicRendering() const { return dynamicRendering_; }
+
+    // Devices lacking any feature enabled here are never selected; the features are enabled on the device.
+    // Must be called before init().
+    void setRequiredDeviceFeatures( const VkPhysicalDeviceFeatures& features );
+
+    // Overrides automatic device selection: either an index into vkEnumeratePhysicalDevices order ("1") or a
+    // case-insensitive substring of the device name ("radeon"). Must be called before init(). When unset, the
+    // VK_RENDERER_DEVICE environment variable is consulted. An override naming an unsuitable device is ignored with
+    // a warning. Otherwise devices are scored: discrete over integrated over virtual over CPU, then device-local memory.
+    void setPreferredDevice( std::string nameOrIndex );
+
+    // Deferred destruction for anything the GPU may still be using. destroy is tagged with frameNumber() and runs
+    // on the render thread once that frame has finished (checked by drawFrame() against the frame fences or the frame
+    // timeline), so releasing a resource never stalls. Entries still pending at shutdown() run after the device is
+    // idle and before it is destroyed, in the order they were deferred. Render thread only.
+    void deferDestroy( std::function<void()> destroy );
+
+    // Handle overload, e.g. deferDestroy( pool, vkDestroyDescriptorPool ).
+    template <typename Handle>
+    void deferDestroy( Handle handle, void( VKAPI_PTR* destroyFn )( VkDevice, Handle, const VkAllocationCallbacks* ) )
+    {
+        deferDestroy( [device = device_, handle, destroyFn] { destroyFn( device, handle, nullptr ); } );
+    }
+
+    // For resources created through allocator().
+    void deferDestroyBuffer( VkBuffer buffer, GpuAllocation* allocation );
+    void deferDestroyImage( VkImage image, GpuAllocation* allocation );
+
+    // Opt in to frame synchronization on one VK_KHR_timeline_semaphore instead of a fence per frame slot. Must be
+    // called before init(); falls back to fences where unsupported. Frame N signals value N on frameTimeline(), so
+    // other queues can wait for a frame with a plain semaphore wait, and nothing is reset between frames.
+    void setTimelineSyncEnabled( bool enabled );
+
+    // Whether the timeline path is active (requested and supported).
+    bool timelineSync() const { return timelineSync_; }
+
+    // Signaled with each frame's number when its commands complete. VK_NULL_HANDLE on the fence path.
+    VkSemaphore frameTimeline() const { return frameTimeline_; }
+
+    // Frames are numbered from 1 in submission order; frameNumber() is the last one submitted. Both work in either
+    // mode (the fence path polls the fence of the slot that covers the frame). Render thread only.
+    bool isFrameComplete( uint64_t frame );
+
+    // Returns false on timeout, or if the frame has not been submitted yet (it could never complete).
+    bool waitForFrame( uint64_t frame, uint64_t timeoutNs = UINT64_MAX );
+
+    // Highest frame known to have completed, as of the last drawFrame(), isFrameComplete() or waitForFrame().
+    uint64_t completedFrameNumber() const { return completedFrames_; }
+
+    // Opt in to a bindless resource table on VK_EXT_descriptor_indexing. Must be called before init(); capacities are
+    // clamped to the device's update-after-bind limits. Without support (or without this call) bindlessTable() still
+    // works, but binds a conventional set per draw; see BindlessTable.
+    void setBindlessEnabled( bool enabled, uint32_t maxImages = 4096, uint32_t maxBuffers = 1024 );
+
+    // Whether the descriptor-indexing path is active (requested and supported).
+    bool descriptorIndexing() const { return descriptorIndexing_; }
+
+    // Valid between init() and shutdown().
+    BindlessTable& bindlessTable() { return bindless_; }
+
+    // Handles stay valid until released. Releasing goes through deferDestroy(), so the index is only reused once
+    // every frame that may still read it has finished. Release before destroying the resource itself.
+    BindlessHandle registerBindlessImage( VkImageView view, VkSampler sampler,
+                                          VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL );
+    BindlessHandle registerBindlessBuffer( VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE );
+    void releaseBindlessImage( BindlessHandle handle );
+    void releaseBindlessBuffer( BindlessHandle handle );
+
+    // File used to persist the pipeline cache across runs (e.g. the app's caches directory on iOS). Must be
+    // called before init(); without it the cache is in-memory only. The cache is saved on shutdown().
+    void setPipelineCachePath( std::string path );
+
+    // Saves now (e.g. when the app is backgrounded, since iOS may kill it without a clean shutdown).
+    bool savePipelineCache();
+
+    // May be called at any time; with a render thread running, the change is posted. A change recreates the swapchain
+    // on the next drawFrame(). Ignored in headless mode, which is never display-paced.
+    void setPresentPolicy( PresentPolicy policy );
+
+    // Render thread only.
+    PresentPolicy presentPolicy() const { return presentPolicy_; }
+
+    // Mode actually in use after fallback.
+    VkPresentModeKHR presentMode() const { return presentMode_; }
+
+    // Reads the next rendered frame back to the CPU. The image is copied into a persistently mapped buffer at the end
+    // of that frame, and callback runs on the render thread from a later drawFrame() (about framesInFlight() frames
+    // on), once the GPU has finished; nothing waits for the GPU. Swapchain pixels are in colorFormat(), typically
+    // BGRA. Returns false if capture is not supported. With a render thread running, calls from other threads are
+    // posted.
+    bool requestCapture( CaptureCallback callback );
+
+    // Opt in to requestCapture(). Must be called before init(). Swapchain images are then created with TRANSFER_SRC
+    // usage, which on MoltenVK turns off framebufferOnly on the CAMetalLayer and costs bandwidth every frame, so
+    // leave it off unless frames are actually read back.
+    void setCaptureEnabled( bool enabled );
+
+    // False unless setCaptureEnabled( true ) was called before init(). Headless targets then always support capture;
+    // swapchain images need TRANSFER_SRC support from the surface. Never in external mode.
+    bool captureSupported() const;
+
     // Getters (useful for ImGui init)
     VkInstance instance() const { return instance_; }
 
     VkPhysicalDevice physicalDevice() const { return physicalDevice_; }
 
+    // Capabilities of the selected device, queried once at init. All zero before init() and after shutdown().
+    const DeviceCaps& deviceCaps() const;
+
+    // Every physical device the instance reported, in enumeration order. Empty before init().
+    const std::vector<DeviceCaps>& availableDevices() const { return devices_; }
+
     VkDevice device() const { return device_; }
 
+    // device()'s functions straight from the driver, bypassing the loader's trampolines. Record callbacks and jobs
+    // can call through it on the hot path (dispatch().vkCmdDraw( ... )). Valid between init() and shutdown().
+    const DeviceDispatch& dispatch() const { return dispatch_; }
+
     VkQueue graphicsQueue() const { return queue_; }
 
     uint32_t graphicsQueueFamilyIndex() const { return queueFamilyIndex_; }
 
     VkRenderPass renderPass() const { return renderPass_; }
 
-    VkCommandPool commandPool() const { return commandPool_; }
+    // Sub-allocator for buffers and images on this device. Valid between init() and shutdown().
+    GpuAllocator& allocator() { return allocator_; }
+
+    // Asynchronous buffer/image uploads. Batches are submitted by drawFrame(); a ticket that isComplete() may be used
+    // by anything recorded afterwards, including the record callbacks of the same drawFrame().
+    UploadQueue& uploads() { return uploads_; }
+
+    // Descriptor set layouts and sets. Transient sets allocated during drawFrame() are recycled framesInFlight frames
+    // later. Valid between init() and shutdown().
+    DescriptorAllocator& descriptors() { return descriptors_; }
+
+    // Queue used by uploads(). May be a dedicated transfer family, a second graphics queue, or the graphics queue.
+    VkQueue transferQueue() const { return transferQueue_; }
+
+    uint32_t transferQueueFamilyIndex() const { return transferFamilyIndex_; }
+
+    // Queue used by submitCompute(): a compute family without graphics when the device has one, else the graphics queue.
+    VkQueue computeQueue() const { return computeQueue_; }
+
+    uint32_t computeQueueFamilyIndex() const { return computeFamilyIndex_; }
+
+    // Whether compute runs on its own queue family, and so can overlap rendering.
+    bool asyncCompute() const { return computeFamilyIndex_ != queueFamilyIndex_; }
+
+    // Shared by all pipelines created against this device (ImGui's and the application's).
+    VkPipelineCache pipelineCache() const { return pipelineCache_.handle(); }
+
+    // Shader modules from embedded SPIR-V (see vk_renderer_add_shaders() in CMake), created once per distinct code.
+    // Valid between init() and shutdown().
+    ShaderModuleCache& shaders() { return shaders_; }
+
+    // Command pool of the frame currently being recorded (pools are per frame in flight).
+    VkCommandPool commandPool() const { return frames_[frameIndex_].commandPool; }
 
     uint32_t imageCount() const { return static_cast<uint32_t>( swapchainImages_.size() ); }
 
     uint32_t minImageCount() const { return swapchainMinImageCount_; }
 
+    bool isHeadless() const { return headless_; }
+
+    VkFormat colorFormat() const { return swapchainFormat_; }
+
+    VkExtent2D extent() const { return swapchainExtent_; }
+
+    uint32_t framesInFlight() const { return framesInFlight_; }
+
+    // Slot in the frame ring that the next drawFrame() will use, in [0, framesInFlight()).
+    uint32_t currentFrameIndex() const { return frameIndex_; }
+
+    // Monotonic count of submitted frames.
+    uint64_t frameNumber() const { return frameNumber_; }
+
+    // Timing of recent frames (min/avg/p99/max per drawFrame phase, plus GPU render pass time). Entries
+    // appear framesInFlight() frames late, once their GPU timestamps are available. Lock-free; callable from
+    // any thread.
+    FrameStats frameStats() const { return frameTimings_.summarize(); }
+
+    // Raw per-frame timings, oldest first, for plotting or export. Returns the number of entries.
+    size_t frameTimings( std::vector<FrameTiming>& out ) const { return frameTimings_.snapshot( out ); }
+
   private:
+    void createInstance( std::vector<const char*> extensions );
     void createInstanceForMetalSurface();
     void createInstanceForGlfw( void* glfwWindow );
+    void createInstanceHeadless();
 
     void createSurfaceFromMetalLayer( void* nativeLayer );
     void createSurfaceFromGlfw( void* glfwWindow );
 
+    void queryDevices();
+    bool isDeviceSuitable( const DeviceCaps& caps, uint32_t& graphicsFamily ) const;
     void pickPhysicalDevice();
     void createDeviceAndQueues();
+    // The device-level helpers every init path shares, in dependency order. On failure the renderer is shut down.
+    bool createDeviceSubsystems();
 
-    void createSwapchain( uint32_t width, uint32_t height );
+    void createSwapchain( uint32_t width, uint32_t height, VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE );
+    void recreateSwapchain();
     void destroySwapchain();
 
+    void createOffscreenTargets( uint32_t width, uint32_t height );
+    void recreateOffscreenTargets();
+    void destroyOffscreenTargets();
+
     void createRenderPass();
     void destroyRenderPass();
 
@@ -69,18 +444,141 @@ class VulkanRenderer
 
     void createSyncObjects();
     void destroySyncObjects();
+    void createTimingQueries();
 
-    void recordCommandBuffer( uint32_t imageIndex );
+    void collectGarbage();
+    void flushDeletionQueue();
+
+    void recordCommandBuffer( VkCommandBuffer cmd, uint32_t imageIndex );
+    void beginRendering( VkCommandBuffer cmd, uint32_t imageIndex, bool secondary );
+    void endRendering( VkCommandBuffer cmd, uint32_t imageIndex );
 
   private:
+    // Secondary command buffers recorded by one thread of workerPool_ for one frame slot. Buffers are
+    // allocated on demand and reused after the slot's pool reset.
+    struct ThreadCommands
+    {
+        VkCommandPool pool = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> buffers;
+        uint32_t used = 0;
+    };
+
+    struct RenderCommand
+    {
+        enum class Type : uint8_t
+        {
+            Resize,
+            Call,
+            Stop,
+        };
+
+        Type type       = Type::Call;
+        uint32_t width  = 0;
+        uint32_t height = 0;
+        std::function<void()> call;
+    };
+
+    struct RecordJob
+    {
+        uint32_t id = 0;
+        RecordCallback record;
+    };
+
+    // Resources owned by one slot of the frame ring. A slot is only reused once its fence has signaled,
+    // so its pool can be reset wholesale instead of resetting individual command buffers.
+    struct FrameResources
+    {
+        VkCommandPool commandPool     = VK_NULL_HANDLE;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkSemaphore imageAvailable    = VK_NULL_HANDLE;
+        VkFence inFlight              = VK_NULL_HANDLE; // fence path only
+        uint64_t submittedFrames      = 0; // frameNumber_ right after this slot's last submit
+
+        // Compute work submitted for the slot's frame; the semaphore is waited on by its graphics submit.
+        VkCommandPool computePool     = VK_NULL_HANDLE;
+        VkCommandBuffer computeBuffer = VK_NULL_HANDLE;
+        VkSemaphore computeFinished   = VK_NULL_HANDLE;
+
+        // Indexed by worker pool thread index (0 is the thread calling drawFrame()).
+        std::vector<ThreadCommands> threadCommands;
+
+        // CPU timing of the slot's last frame, waiting for its GPU timestamps.
+        FrameTiming timing;
+        bool timingPending = false;
+    };
+
+    void publishFrameTiming( FrameResources& frame );
+
+    void resetSecondaryCommandBuffers( FrameResources& frame );
+    VkCommandBuffer nextSecondaryCommandBuffer( ThreadCommands& commands );
+    void startRecordThreads();
+    void recordSecondaryCommandBuffers( FrameResources& frame, uint32_t imageIndex );
+    void markSwapchainDirty( bool outOfDate );
+    bool applyPendingResize( double& recreateMs );
+    VkPipelineStageFlags submitComputeJobs( FrameResources& frame );
+
+    void consumeFrameRequest();
+    void applyResize( uint32_t width, uint32_t height );
+    void pushRenderCommand( RenderCommand&& command );
+    void wakeRenderThread();
+    void renderThreadMain();
+
+    struct ComputeJob
+    {
+        RecordCallback record;
+        VkPipelineStageFlags dstStages = 0;
+    };
+
+    struct PendingDestroy
+    {
+        uint64_t frame = 0; // frameNumber_ when retired; safe once completedFrames_ reaches it
+        std::function<void()> destroy;
+    };
+
     bool initialized_    = false;
     bool swapchainDirty_ = false;
+    bool headless_       = false;
+    bool external_       = false;
+
+    // External mode: beginExternalFrame() ran and recordExternalFrame() has not yet.
+    bool externalFrameOpen_ = false;
+
+    // Resize policy
+    ResizePolicy resizePolicy_;
+    ResizeStats resizeStats_;
+    bool swapchainOutOfDate_ = false; // the old swapchain can no longer be presented to
+    std::chrono::steady_clock::time_point lastResize_;
+    std::chrono::steady_clock::time_point lastRecreate_;
+
+    // Render thread
+    std::thread renderThread_;
+    std::atomic<bool> renderThreadActive_{ false }; // read by invalidate() from any thread
+    SpscQueue<RenderCommand, 256> renderCommands_;
+    std::thread::id renderThreadPoster_; // the producer of renderCommands_: the thread that started the render thread
+    std::mutex renderWakeMutex_;
+    std::condition_variable renderWake_;
+    std::atomic<bool> renderThreadSleeping_{ false };
+
+    // Render on demand
+    std::atomic<bool> renderOnDemand_{ false };
+    std::atomic<uint32_t> requestedFrames_{ 0 };
+    uint64_t idleFrames_ = 0;
 
     uint32_t width_  = 1;
     uint32_t height_ = 1;
 
     RecordCallback recordCallback_;
 
+    // Parallel recording
+    std::vector<RecordJob> recordJobs_;
+    std::atomic<uint32_t> nextRecordJobId_{ 1 }; // handed out on the calling thread, before the job is posted
+    uint32_t recordWorkers_ = WorkerPool::defaultWorkerCount();
+    WorkerPool workerPool_;
+    std::vector<VkCommandBuffer> secondaryBuffers_; // this frame's, in execution order
+
+    // Compute jobs queued for the next frame
+    std::vector<ComputeJob> computeJobs_;
+
     // Vulkan core
     VkInstance instance_             = VK_NULL_HANDLE;
     VkSurfaceKHR surface_            = VK_NULL_HANDLE;
@@ -88,26 +586,85 @@ class VulkanRenderer
     VkDevice device_                 = VK_NULL_HANDLE;
     VkQueue queue_                   = VK_NULL_HANDLE;
     uint32_t queueFamilyIndex_       = 0;
+    VkQueue transferQueue_           = VK_NULL_HANDLE;
+    uint32_t transferFamilyIndex_    = 0;
+    VkQueue computeQueue_            = VK_NULL_HANDLE;
+    uint32_t computeFamilyIndex_     = 0;
+    DeviceDispatch dispatch_; // device_'s functions, called without loader trampolines on the per-frame paths
+
+    // Device selection
+    std::vector<DeviceCaps> devices_; // snapshot of every physical device, taken once per instance
+    size_t deviceIndex_ = 0;
+    VkPhysicalDeviceFeatures requiredFeatures_{};
+    std::string preferredDevice_;
+
+    GpuAllocator allocator_;
+    UploadQueue uploads_;
+    VkDeviceSize uploadRingSize_ = 32ull * 1024 * 1024;
+    PipelineCache pipelineCache_;
+    ShaderModuleCache shaders_;
+    FrameCapture capture_;
+    DescriptorAllocator descriptors_;
+    BindlessTable bindless_;
+    bool wantBindless_        = false;
+    bool descriptorIndexing_  = false;
+    uint32_t bindlessImages_  = 4096;
+    uint32_t bindlessBuffers_ = 1024;
+    std::string pipelineCachePath_;
 
     // Swapchain + views
     VkSwapchainKHR swapchain_ = VK_NULL_HANDLE;
     VkFormat swapchainFormat_ = VK_FORMAT_UNDEFINED;
     VkExtent2D swapchainExtent_{};
     uint32_t swapchainMinImageCount_ = 2;
+    bool wantCapture_                = false;
+    bool swapchainTransferSrc_       = false; // wantCapture_ and supported by the surface
 
+    PresentPolicy presentPolicy_  = PresentPolicy::PowerSaving;
+    VkPresentModeKHR presentMode_ = VK_PRESENT_MODE_FIFO_KHR;
+
+    // In headless mode these hold the renderer-owned offscreen targets (one per frame in flight).
     std::vector<VkImage> swapchainImages_;
     std::vector<VkImageView> swapchainImageViews_;
 
-    // Render pass + framebuffers (needed for ImGui)
+    // Headless only
+    VkFormat offscreenFormat_ = VK_FORMAT_R8G8B8A8_UNORM;
+    std::vector<GpuAllocation*> offscreenMemory_;
+
+    // Per swapchain image: signaled when rendering to the image finishes, waited on by present.
+    std::vector<VkSemaphore> renderFinished_;
+    // Per swapchain image: number of the frame that last rendered to it.
+    std::vector<uint64_t> imageFrames_;
+
+    // Render pass + framebuffers (needed for ImGui); both stay empty on the dynamic rendering path
     VkRenderPass renderPass_ = VK_NULL_HANDLE;
     std::vector<VkFramebuffer> framebuffers_;
 
-    // Commands
-    VkCommandPool commandPool_ = VK_NULL_HANDLE;
-    std::vector<VkCommandBuffer> commandBuffers_;
-
-    // Sync
-    VkSemaphore imageAvailable_ = VK_NULL_HANDLE;
-    VkSemaphore renderFinished_ = VK_NULL_HANDLE;
-    VkFence inFlight_           = VK_NULL_HANDLE;
+    bool wantDynamicRendering_ = false;
+    bool dynamicRendering_     = false;
+
+    // Frame ring (commands + sync)
+    std::array<FrameResources, kMaxFramesInFlight> frames_{};
+    uint32_t framesInFlight_ = 2;
+    uint32_t frameIndex_     = 0;
+    uint64_t frameNumber_    = 0;
+
+    // Timeline frame sync
+    bool wantTimelineSync_     = false;
+    bool timelineSync_         = false;
+    VkSemaphore frameTimeline_ = VK_NULL_HANDLE;
+
+    // Semaphores (and their stages) the current frame's submit waits on.
+    std::vector<VkSemaphore> frameWaitSemaphores_;
+    std::vector<VkPipelineStageFlags> frameWaitStages_;
+
+    // Instrumentation
+    FrameTimingRing frameTimings_;
+    VkQueryPool timestampPool_   = VK_NULL_HANDLE;
+    float timestampPeriod_       = 0.0f;
+    uint32_t timestampValidBits_ = 0;
+
+    // Deferred destruction, keyed on frame completion
+    std::deque<PendingDestroy> deletionQueue_;
+    uint64_t completedFrames_ = 0;
 };
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#if defined( VK_USE_PLATFORM_METAL_EXT )
+#include <vulkan/vulkan_metal.h>
+#endif
+
+// Vulkan entry points the renderer uses, as X-macro lists: X( name ) for each function.
+//
+// Two ways of reaching them:
+//
+// - DeviceDispatch: device-level functions fetched with vkGetDeviceProcAddr for one device. Calls through it go
+//   straight to the driver, skipping the loader's trampoline (a dispatch-table lookup and an indirect jump per call).
+//   The renderer loads one after creating its device, uses it on the per-frame paths (its upload queue, frame capture
+//   and bindless table included), and hands it out through VulkanRenderer::dispatch() for record callbacks.
+//
+// - Dynamic loading (VK_RENDERER_DYNAMIC_LOADER in CMake, which defines VK_NO_PROTOTYPES): nothing links against the
+//   loader. The functions below become global function pointers with the usual names, so code calling vkFoo() still
+//   compiles, and are filled by loadVulkanLibrary() and loadVulkanInstanceFunctions(); the renderer's init functions
+//   call both. Device-level globals are the instance's trampolines, so they work with any device in the process,
+//   including a host's or a second renderer's. The library can be the loader or MoltenVK itself (an ICD that exports
+//   the entry points), which skips the loader entirely on Apple platforms.
+
+// Loaded from the library; usable without an instance.
+#define VK_RENDERER_GLOBAL_FUNCTIONS( X )                                                                                                  \
+    X( vkCreateInstance )                                                                                                                  \
+    X( vkEnumerateInstanceExtensionProperties )                                                                                            \
+    X( vkEnumerateInstanceVersion )
+
+#define VK_RENDERER_INSTANCE_FUNCTIONS( X )                                                                                                \
+    X( vkDestroyInstance )                                                                                                                 \
+    X( vkEnumeratePhysicalDevices )                                                                                                        \
+    X( vkEnumerateDeviceExtensionProperties )                                                                                              \
+    X( vkGetPhysicalDeviceProperties )                                                                                                     \
+    X( vkGetPhysicalDeviceProperties2 )                                                                                                    \
+    X( vkGetPhysicalDeviceFeatures )                                                                                                       \
+    X( vkGetPhysicalDeviceFeatures2 )                                                                                                      \
+    X( vkGetPhysicalDeviceMemoryProperties )                                                                                               \
+    X( vkGetPhysicalDeviceQueueFamilyProperties )                                                                                          \
+    X( vkGetPhysicalDeviceFormatProperties )                                                                                               \
+    X( vkCreateDevice )                                                                                                                    \
+    X( vkGetDeviceProcAddr )                                                                                                               \
+    X( vkDestroySurfaceKHR )                                                                                                               \
+    X( vkGetPhysicalDeviceSurfaceSupportKHR )                                                                                              \
+    X( vkGetPhysicalDeviceSurfaceCapabilitiesKHR )                                                                                         \
+    X( vkGetPhysicalDeviceSurfaceFormatsKHR )                                                                                              \
+    X( vkGetPhysicalDeviceSurfacePresentModesKHR )
+
+#if defined( VK_USE_PLATFORM_METAL_EXT )
+#define VK_RENDERER_METAL_FUNCTIONS( X ) X( vkCreateMetalSurfaceEXT )
+#else
+#define VK_RENDERER_METAL_FUNCTIONS( X )
+#endif
+
+// Core device-level functions, including the common vkCmd* ones record callbacks need.
+#define VK_RENDERER_DEVICE_FUNCTIONS( X )                                                                                                  \
+    X( vkDestroyDevice )                                                                                                                   \
+    X( vkGetDeviceQueue )                                                                                                                  \
+    X( vkDeviceWaitIdle )                                                                                                                  \
+    X( vkQueueSubmit )                                                                                                                     \
+    X( vkQueueWaitIdle )                                                                                                                   \
+    X( vkAllocateMemory )                                                                                                                  \
+    X( vkFreeMemory )                                                                                                                      \
+    X( vkMapMemory )                                                                                                                       \
+    X( vkUnmapMemory )                                                                                                                     \
+    X( vkFlushMappedMemoryRanges )                                                                                                         \
+    X( vkInvalidateMappedMemoryRanges )                                                                                                    \
+    X( vkCreateBuffer )                                                                                                                    \
+    X( vkDestroyBuffer )                                                                                                                   \
+    X( vkBindBufferMemory )                                                                                                                \
+    X( vkGetBufferMemoryRequirements )                                                                                                     \
+    X( vkGetBufferMemoryRequirements2 )                                                                                                    \
+    X( vkCreateImage )                                                                                                                     \
+    X( vkDestroyImage )                                                                                                                    \
+    X( vkBindImageMemory )                                                                                                                 \
+    X( vkGetImageMemoryRequirements )                                                                                                      \
+    X( vkGetImageMemoryRequirements2 )                                                                                                     \
+    X( vkCreateImageView )                                                                                                                 \
+    X( vkDestroyImageView )                                                                                                                \
+    X( vkCreateSampler )                                                                                                                   \
+    X( vkDestroySampler )                                                                                                                  \
+    X( vkCreateFence )                                                                                                                     \
+    X( vkDestroyFence )                                                                                                                    \
+    X( vkResetFences )                                                                                                                     \
+    X( vkGetFenceStatus )                                                                                                                  \
+    X( vkWaitForFences )                                                                                                                   \
+    X( vkCreateSemaphore )                                                                                                                 \
+    X( vkDestroySemaphore )                                                                                                                \
+    X( vkCreateQueryPool )                                                                                                                 \
+    X( vkDestroyQueryPool )                                                                                                                \
+    X( vkGetQueryPoolResults )                                                                                                             \
+    X( vkCreateShaderModule )                                                                                                              \
+    X( vkDestroyShaderModule )                                                                                                             \
+    X( vkCreatePipelineCache )                                                                                                             \
+    X( vkDestroyPipelineCache )                                                                                                            \
+    X( vkGetPipelineCacheData )                                                                                                            \
+    X( vkCreateGraphicsPipelines )                                                                                                         \
+    X( vkCreateComputePipelines )                                                                                                          \
+    X( vkDestroyPipeline )                                                                                                                 \
+    X( vkCreatePipelineLayout )                                                                                                            \
+    X( vkDestroyPipelineLayout )                                                                                                           \
+    X( vkCreateDescriptorSetLayout )                                                                                                       \
+    X( vkDestroyDescriptorSetLayout )                                                                                                      \
+    X( vkCreateDescriptorPool )                                                                                                            \
+    X( vkDestroyDescriptorPool )                                                                                                           \
+    X( vkResetDescriptorPool )                                                                                                             \
+    X( vkAllocateDescriptorSets )                                                                                                          \
+    X( vkFreeDescriptorSets )                                                                                                              \
+    X( vkUpdateDescriptorSets )                                                                                                            \
+    X( vkCreateFramebuffer )                                                                                                               \
+    X( vkDestroyFramebuffer )                                                                                                              \
+    X( vkCreateRenderPass )                                                                                                                \
+    X( vkDestroyRenderPass )                                                                                                               \
+    X( vkCreateCommandPool )                                                                                                               \
+    X( vkDestroyCommandPool )                                                                                                              \
+    X( vkResetCommandPool )                                                                                                                \
+    X( vkAllocateCommandBuffers )                                                                                                          \
+    X( vkFreeCommandBuffers )                                                                                                              \
+    X( vkBeginCommandBuffer )                                                                                                              \
+    X( vkEndCommandBuffer )                                                                                                                \
+    X( vkResetCommandBuffer )                                                                                                              \
+    X( vkCmdBindPipeline )                                                                                                                 \
+    X( vkCmdSetViewport )                                                                                                                  \
+    X( vkCmdSetScissor )                                                                                                                   \
+    X( vkCmdBindDescriptorSets )                                                                                                           \
+    X( vkCmdBindIndexBuffer )                                                                                                              \
+    X( vkCmdBindVertexBuffers )                                                                                                            \
+    X( vkCmdDraw )                                                                                                                         \
+    X( vkCmdDrawIndexed )                                                                                                                  \
+    X( vkCmdDispatch )                                                                                                                     \
+    X( vkCmdCopyBuffer )                                                                                                                   \
+    X( vkCmdBlitImage )                                                                                                                    \
+    X( vkCmdCopyBufferToImage )                                                                                                            \
+    X( vkCmdCopyImageToBuffer )                                                                                                            \
+    X( vkCmdPipelineBarrier )                                                                                                              \
+    X( vkCmdResetQueryPool )                                                                                                               \
+    X( vkCmdWriteTimestamp )                                                                                                               \
+    X( vkCmdPushConstants )                                                                                                                \
+    X( vkCmdBeginRenderPass )                                                                                                              \
+    X( vkCmdEndRenderPass )                                                                                                                \
+    X( vkCmdExecuteCommands )
+
+// VK_KHR_swapchain; null on devices without it (headless and external modes).
+#define VK_RENDERER_SWAPCHAIN_FUNCTIONS( X )                                                                                               \
+    X( vkCreateSwapchainKHR )                                                                                                              \
+    X( vkDestroySwapchainKHR )                                                                                                             \
+    X( vkGetSwapchainImagesKHR )                                                                                                           \
+    X( vkAcquireNextImageKHR )                                                                                                             \
+    X( vkQueuePresentKHR )
+
+// Extensions promoted to core in later versions; null unless enabled on the device. Only reachable through
+// DeviceDispatch.
+#define VK_RENDERER_DEVICE_EXTENSION_FUNCTIONS( X )                                                                                        \
+    X( vkCmdBeginRenderingKHR )                                                                                                            \
+    X( vkCmdEndRenderingKHR )                                                                                                              \
+    X( vkGetSemaphoreCounterValueKHR )                                                                                                     \
+    X( vkWaitSemaphoresKHR )
+
+// Device-level functions of one VkDevice, called without the loader's trampolines. Plain data: copy it freely.
+// Core functions are non-null after a successful load(); the others only when their extension is enabled.
+struct DeviceDispatch
+{
+#define VK_RENDERER_DISPATCH_MEMBER( name ) PFN_##name name = nullptr;
+    VK_RENDERER_DEVICE_FUNCTIONS( VK_RENDERER_DISPATCH_MEMBER )
+    VK_RENDERER_SWAPCHAIN_FUNCTIONS( VK_RENDERER_DISPATCH_MEMBER )
+    VK_RENDERER_DEVICE_EXTENSION_FUNCTIONS( VK_RENDERER_DISPATCH_MEMBER )
+#undef VK_RENDERER_DISPATCH_MEMBER
+
+    // False if a core function is missing. Needs vkGetDeviceProcAddr, so in dynamic builds the instance functions
+    // must be loaded first.
+    bool load( VkDevice device );
+};
+
+#if defined( VK_NO_PROTOTYPES )
+#define VK_RENDERER_DECLARE_FUNCTION( name ) extern PFN_##name name;
+extern PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr;
+VK_RENDERER_GLOBAL_FUNCTIONS( VK_RENDERER_DECLARE_FUNCTION )
+VK_RENDERER_INSTANCE_FUNCTIONS( VK_RENDERER_DECLARE_FUNCTION )
+VK_RENDERER_METAL_FUNCTIONS( VK_RENDERER_DECLARE_FUNCTION )
+VK_RENDERER_DEVICE_FUNCTIONS( VK_RENDERER_DECLARE_FUNCTION )
+VK_RENDERER_SWAPCHAIN_FUNCTIONS( VK_RENDERER_DECLARE_FUNCTION )
+#undef VK_RENDERER_DECLARE_FUNCTION
+#endif
+
+// Dynamic builds: opens the library and loads vkGetInstanceProcAddr and the global functions. path overrides the
+// search, as does the VK_RENDERER_VULKAN_LIBRARY environment variable; otherwise the loader is tried, then (on
+// Apple platforms) libMoltenVK.dylib. The library stays loaded for the life of the process; repeated calls return
+// the first result. Static builds link the loader and always return true.
+bool loadVulkanLibrary( const char* path = nullptr );
+
+// Dynamic builds: loads the instance-level functions for instance, replacing those of any previous instance, and the
+// device-level ones as its trampolines. No-op in static builds.
+void loadVulkanInstanceFunctions( VkInstance instance );
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for fork/join parallel loops. The calling thread takes part as thread 0,
+// workers are threads 1..workerCount, so per-thread resources can be indexed by threadIndex directly.
+class WorkerPool
+{
+  public:
+    using Task = std::function<void( uint32_t item, uint32_t threadIndex )>;
+
+    WorkerPool() = default;
+    ~WorkerPool();
+
+    WorkerPool( const WorkerPool& )            = delete;
+    WorkerPool& operator=( const WorkerPool& ) = delete;
+
+    // One less than the number of hardware threads, leaving a core for the calling thread.
+    static uint32_t defaultWorkerCount();
+
+    void start( uint32_t workerCount );
+    void stop();
+
+    // Worker threads plus the calling thread.
+    uint32_t threadCount() const { return static_cast<uint32_t>( workers_.size() ) + 1; }
+
+    // Runs task for every item in [0, count), distributing items dynamically, and returns once all are done.
+    // Must only be called from one thread at a time.
+    void parallelFor( uint32_t count, const Task& task );
+
+  private:
+    void workerLoop( uint32_t threadIndex );
+    void drain( uint32_t threadIndex );
+
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    uint64_t generation_ = 0;
+    uint32_t busy_       = 0;
+    bool stopping_       = false;
+
+    const Task* task_ = nullptr;
+    uint32_t count_   = 0;
+    std::atomic<uint32_t> next_{ 0 };
+};
@@ -0,0 +1,14 @@
+#version 450
+
+layout( location = 0 ) in vec4 inColor;
+layout( location = 1 ) in vec2 inUv;
+
+layout( location = 0 ) out vec4 outColor;
+
+void main()
+{
+    // Round sprites with a soft edge; the pipeline uses straight (not premultiplied) alpha blending.
+    float d     = length( inUv * 2.0 - 1.0 );
+    float alpha = 1.0 - smoothstep( 0.9, 1.0, d );
+    outColor    = vec4( inColor.rgb, inColor.a * alpha );
+}
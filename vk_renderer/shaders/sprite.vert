@@ -0,0 +1,27 @@
+#version 450
+
+// SpriteBatch: one instance per sprite, a 4-vertex triangle strip per quad. Positions are sprite centres in pixels
+// from the top-left corner of the target, each axis streamed from its own array.
+
+layout( location = 0 ) in float inX;
+layout( location = 1 ) in float inY;
+layout( location = 2 ) in vec4 inColor;
+
+layout( push_constant ) uniform Push
+{
+    vec2 invExtent; // 1 / target size in pixels
+    vec2 halfSize;  // sprite half extent in pixels
+} pc;
+
+layout( location = 0 ) out vec4 outColor;
+layout( location = 1 ) out vec2 outUv;
+
+void main()
+{
+    vec2 corner = vec2( gl_VertexIndex & 1, gl_VertexIndex >> 1 );
+    vec2 pixel  = vec2( inX, inY ) + ( corner * 2.0 - 1.0 ) * pc.halfSize;
+
+    gl_Position = vec4( pixel * pc.invExtent * 2.0 - 1.0, 0.0, 1.0 );
+    outColor    = inColor;
+    outUv       = corner;
+}
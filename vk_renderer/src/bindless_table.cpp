@@ -0,0 +1,327 @@
+#include "vk_check.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <vk_renderer/bindless_table.hpp>
+#include <vk_renderer/descriptor_allocator.hpp>
+
+static constexpr uint32_t kBufferBinding = 0;
+static constexpr uint32_t kImageBinding  = 1;
+
+void IndexAllocator::reset( uint32_t capacity )
+{
+    free_.clear();
+    isFree_.clear();
+    next_     = 0;
+    capacity_ = capacity;
+}
+
+uint32_t IndexAllocator::allocate()
+{
+    if( !free_.empty() )
+    {
+        const uint32_t index = free_.back();
+        free_.pop_back();
+        isFree_[index] = false;
+        return index;
+    }
+
+    if( next_ == capacity_ )
+        return kInvalid;
+
+    isFree_.push_back( false );
+    return next_++;
+}
+
+void IndexAllocator::release( uint32_t index )
+{
+    if( index >= next_ )
+        return;
+
+    // A second release would hand the index out twice.
+    if( isFree_[index] )
+    {
+        std::fprintf( stderr, "IndexAllocator: index %u released twice; ignoring the second release.\n", index );
+        return;
+    }
+
+    isFree_[index] = true;
+    free_.push_back( index );
+}
+
+BindlessTable::~BindlessTable()
+{
+    destroy();
+}
+
+bool BindlessTable::create( VkDevice device, const DeviceDispatch& vk, DescriptorAllocator& descriptors, bool descriptorIndexing,
+                            const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& limits, uint32_t maxImages, uint32_t maxBuffers )
+{
+    device_      = device;
+    vk_          = &vk;
+    descriptors_ = &descriptors;
+    bindless_    = descriptorIndexing;
+
+    if( bindless_ )
+    {
+        // Both arrays are visible to every stage, so the per-stage limits apply to each.
+        maxImages  = std::min( { maxImages, limits.maxDescriptorSetUpdateAfterBindSampledImages,
+                                 limits.maxPerStageDescriptorUpdateAfterBindSampledImages, limits.maxDescriptorSetUpdateAfterBindSamplers,
+                                 limits.maxPerStageDescriptorUpdateAfterBindSamplers } );
+        maxBuffers = std::min( { maxBuffers, limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+                                 limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers } );
+
+        const uint32_t resources = std::min( limits.maxPerStageUpdateAfterBindResources, limits.maxUpdateAfterBindDescriptorsInAllPools );
+        if( maxBuffers >= resources )
+        {
+            maxBuffers = resources / 2;
+        }
+        maxImages = std::min( maxImages, resources - maxBuffers );
+    }
+    maxImages  = std::max( maxImages, 1u );
+    maxBuffers = std::max( maxBuffers, 1u );
+
+    imageIndices_.reset( maxImages );
+    bufferIndices_.reset( maxBuffers );
+    images_.assign( maxImages, VkDescriptorImageInfo{} );
+    buffers_.assign( maxBuffers, VkDescriptorBufferInfo{} );
+
+    if( !bindless_ )
+    {
+        const auto types = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER };
+        layout_          = descriptors.layout( types, VK_SHADER_STAGE_ALL );
+        return layout_ != VK_NULL_HANDLE;
+    }
+
+    VkDescriptorSetLayoutBinding bindings[2]{};
+    bindings[kBufferBinding].binding         = kBufferBinding;
+    bindings[kBufferBinding].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[kBufferBinding].descriptorCount = maxBuffers;
+    bindings[kBufferBinding].stageFlags      = VK_SHADER_STAGE_ALL;
+    bindings[kImageBinding].binding          = kImageBinding;
+    bindings[kImageBinding].descriptorType   = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[kImageBinding].descriptorCount  = maxImages;
+    bindings[kImageBinding].stageFlags       = VK_SHADER_STAGE_ALL;
+
+    // Only the last binding may have a variable count; images are the one that grows large.
+    const VkDescriptorBindingFlagsEXT common = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+                                               VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT |
+                                               VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT;
+    const VkDescriptorBindingFlagsEXT bindingFlags[2] = { common, common | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flagsInfo{};
+    flagsInfo.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    flagsInfo.bindingCount  = 2;
+    flagsInfo.pBindingFlags = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo lci{};
+    lci.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    lci.pNext        = &flagsInfo;
+    lci.flags        = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+    lci.bindingCount = 2;
+    lci.pBindings    = bindings;
+    VK_CHECK( vk_->vkCreateDescriptorSetLayout( device_, &lci, nullptr, &layout_ ) );
+
+    const VkDescriptorPoolSize sizes[2] = {
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxBuffers },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxImages },
+    };
+
+    VkDescriptorPoolCreateInfo pci{};
+    pci.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pci.flags         = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+    pci.maxSets       = 1;
+    pci.poolSizeCount = 2;
+    pci.pPoolSizes    = sizes;
+    VK_CHECK( vk_->vkCreateDescriptorPool( device_, &pci, nullptr, &pool_ ) );
+
+    VkDescriptorSetVariableDescriptorCountAllocateInfoEXT countInfo{};
+    countInfo.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
+    countInfo.descriptorSetCount = 1;
+    countInfo.pDescriptorCounts  = &maxImages;
+
+    VkDescriptorSetAllocateInfo ai{};
+    ai.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    ai.pNext              = &countInfo;
+    ai.descriptorPool     = pool_;
+    ai.descriptorSetCount = 1;
+    ai.pSetLayouts        = &layout_;
+    VK_CHECK( vk_->vkAllocateDescriptorSets( device_, &ai, &set_ ) );
+
+    return true;
+}
+
+void BindlessTable::destroy()
+{
+    if( device_ == VK_NULL_HANDLE )
+        return;
+
+    if( bindless_ )
+    {
+        vk_->vkDestroyDescriptorPool( device_, pool_, nullptr );
+        vk_->vkDestroyDescriptorSetLayout( device_, layout_, nullptr );
+    }
+
+    pool_        = VK_NULL_HANDLE;
+    set_         = VK_NULL_HANDLE;
+    layout_      = VK_NULL_HANDLE;
+    descriptors_ = nullptr;
+    bindless_    = false;
+    imageIndices_.reset( 0 );
+    bufferIndices_.reset( 0 );
+    images_.clear();
+    buffers_.clear();
+
+    device_ = VK_NULL_HANDLE;
+}
+
+BindlessHandle BindlessTable::registerImage( VkImageView view, VkSampler sampler, VkImageLayout layout )
+{
+    std::lock_guard<std::mutex> lock( mutex_ );
+
+    BindlessHandle handle{ imageIndices_.allocate() };
+    if( !handle.valid() )
+    {
+        std::fprintf( stderr, "BindlessTable: all %u image slots in use.\n", imageIndices_.capacity() );
+        return handle;
+    }
+
+    VkDescriptorImageInfo& info = images_[handle.index];
+    info.sampler                = sampler;
+    info.imageView              = view;
+    info.imageLayout            = layout;
+
+    if( bindless_ )
+    {
+        VkWriteDescriptorSet write{};
+        write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet          = set_;
+        write.dstBinding      = kImageBinding;
+        write.dstArrayElement = handle.index;
+        write.descriptorCount = 1;
+        write.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo      = &info;
+        vk_->vkUpdateDescriptorSets( device_, 1, &write, 0, nullptr );
+    }
+
+    return handle;
+}
+
+BindlessHandle BindlessTable::registerBuffer( VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range )
+{
+    std::lock_guard<std::mutex> lock( mutex_ );
+
+    BindlessHandle handle{ bufferIndices_.allocate() };
+    if( !handle.valid() )
+    {
+        std::fprintf( stderr, "BindlessTable: all %u buffer slots in use.\n", bufferIndices_.capacity() );
+        return handle;
+    }
+
+    VkDescriptorBufferInfo& info = buffers_[handle.index];
+    info.buffer                  = buffer;
+    info.offset                  = offset;
+    info.range                   = range;
+
+    if( bindless_ )
+    {
+        VkWriteDescriptorSet write{};
+        write.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet          = set_;
+        write.dstBinding      = kBufferBinding;
+        write.dstArrayElement = handle.index;
+        write.descriptorCount = 1;
+        write.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pBufferInfo     = &info;
+        vk_->vkUpdateDescriptorSets( device_, 1, &write, 0, nullptr );
+    }
+
+    return handle;
+}
+
+void BindlessTable::releaseImage( BindlessHandle handle )
+{
+    // Invalid handles, and releases that run after destroy(), are out of range. The stale descriptor stays in the
+    // set; partially bound means nothing reads it until the index is reused.
+    std::lock_guard<std::mutex> lock( mutex_ );
+    if( handle.index >= images_.size() )
+        return;
+
+    images_[handle.index] = VkDescriptorImageInfo{};
+    imageIndices_.release( handle.index );
+}
+
+void BindlessTable::releaseBuffer( BindlessHandle handle )
+{
+    std::lock_guard<std::mutex> lock( mutex_ );
+    if( handle.index >= buffers_.size() )
+        return;
+
+    buffers_[handle.index] = VkDescriptorBufferInfo{};
+    bufferIndices_.release( handle.index );
+}
+
+void BindlessTable::bind( VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t firstSet,
+                          BindlessHandle image, BindlessHandle buffer )
+{
+    if( bindless_ )
+    {
+        vk_->vkCmdBindDescriptorSets( cmd, bindPoint, pipelineLayout, firstSet, 1, &set_, 0, nullptr );
+        return;
+    }
+
+    const VkDescriptorSet set = descriptors_->allocateTransient( layout_ );
+    if( set == VK_NULL_HANDLE )
+        return;
+
+    VkDescriptorImageInfo imageInfo{};
+    VkDescriptorBufferInfo bufferInfo{};
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+        if( image.valid() )
+            imageInfo = images_[image.index];
+        if( buffer.valid() )
+            bufferInfo = buffers_[buffer.index];
+    }
+
+    VkWriteDescriptorSet writes[2]{};
+    uint32_t writeCount = 0;
+    if( bufferInfo.buffer != VK_NULL_HANDLE )
+    {
+        VkWriteDescriptorSet& w = writes[writeCount++];
+        w.sType                 = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        w.dstSet                = set;
+        w.dstBinding            = kBufferBinding;
+        w.descriptorCount       = 1;
+        w.descriptorType        = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        w.pBufferInfo           = &bufferInfo;
+    }
+    if( imageInfo.imageView != VK_NULL_HANDLE )
+    {
+        VkWriteDescriptorSet& w = writes[writeCount++];
+        w.sType                 = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        w.dstSet                = set;
+        w.dstBinding            = kImageBinding;
+        w.descriptorCount       = 1;
+        w.descriptorType        = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        w.pImageInfo            = &imageInfo;
+    }
+    if( writeCount > 0 )
+    {
+        vk_->vkUpdateDescriptorSets( device_, writeCount, writes, 0, nullptr );
+    }
+
+    vk_->vkCmdBindDescriptorSets( cmd, bindPoint, pipelineLayout, firstSet, 1, &set, 0, nullptr );
+}
+
+uint32_t BindlessTable::imageCount() const
+{
+    std::lock_guard<std::mutex> lock( mutex_ );
+    return imageIndices_.inUse();
+}
+
+uint32_t BindlessTable::bufferCount() const
+{
+    std::lock_guard<std::mutex> lock( mutex_ );
+    return bufferIndices_.inUse();
+}
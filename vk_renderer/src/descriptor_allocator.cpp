@@ -0,0 +1,347 @@
+#include "vk_check.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <vk_renderer/descriptor_allocator.hpp>
+
+// The first pool of a list holds this many sets; each further one twice the last, up to the cap.
+static constexpr uint32_t kInitialSetsPerPool = 32;
+static constexpr uint32_t kMaxSetsPerPool     = 4096;
+
+static uint64_t hashCombine( uint64_t hash, uint64_t value )
+{
+    // FNV-1a over the value's bytes.
+    for( int i = 0; i < 8; ++i )
+    {
+        hash ^= ( value >> ( 8 * i ) ) & 0xFF;
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+    destroy();
+}
+
+void DescriptorAllocator::create( VkDevice device, uint32_t frameSlots )
+{
+    device_     = device;
+    frameSlot_  = 0;
+    demandSets_ = 0;
+    demand_.fill( 0 );
+    frames_.resize( frameSlots );
+}
+
+void DescriptorAllocator::destroy()
+{
+    if( device_ == VK_NULL_HANDLE )
+        return;
+
+    std::lock_guard<std::mutex> lock( mutex_ );
+
+    destroyList( persistent_ );
+    for( auto& list : frames_ )
+    {
+        destroyList( list );
+    }
+    frames_.clear();
+
+    for( auto pool : standalone_ )
+    {
+        vkDestroyDescriptorPool( device_, pool, nullptr );
+    }
+    standalone_.clear();
+
+    for( auto& [hash, entries] : layouts_ )
+    {
+        for( auto& entry : entries )
+        {
+            vkDestroyDescriptorSetLayout( device_, entry.layout, nullptr );
+        }
+    }
+    layouts_.clear();
+    layoutCounts_.clear();
+    layoutCount_ = 0;
+
+    device_ = VK_NULL_HANDLE;
+}
+
+void DescriptorAllocator::destroyList( PoolList& list )
+{
+    if( list.current != VK_NULL_HANDLE )
+    {
+        vkDestroyDescriptorPool( device_, list.current, nullptr );
+    }
+    for( auto* pools : { &list.full, &list.ready } )
+    {
+        for( auto pool : *pools )
+        {
+            vkDestroyDescriptorPool( device_, pool, nullptr );
+        }
+    }
+    list = PoolList{};
+}
+
+VkDescriptorSetLayout DescriptorAllocator::layout( const VkDescriptorSetLayoutCreateInfo& info )
+{
+    if( info.pNext != nullptr )
+    {
+        std::fprintf( stderr, "DescriptorAllocator: layouts with a pNext chain are not cached.\n" );
+        return VK_NULL_HANDLE;
+    }
+
+    CachedLayout key;
+    key.flags = info.flags;
+    key.bindings.assign( info.pBindings, info.pBindings + info.bindingCount );
+    std::sort( key.bindings.begin(), key.bindings.end(),
+               []( const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b ) { return a.binding < b.binding; } );
+
+    // Immutable samplers are compared by handle; the pointers in the bindings are not kept.
+    uint64_t hash = hashCombine( 0xCBF29CE484222325ull, key.flags );
+    for( auto& b : key.bindings )
+    {
+        hash = hashCombine( hash, b.binding );
+        hash = hashCombine( hash, static_cast<uint64_t>( b.descriptorType ) );
+        hash = hashCombine( hash, b.descriptorCount );
+        hash = hashCombine( hash, b.stageFlags );
+        if( b.pImmutableSamplers != nullptr )
+        {
+            for( uint32_t i = 0; i < b.descriptorCount; ++i )
+            {
+                key.immutableSamplers.push_back( b.pImmutableSamplers[i] );
+                hash = hashCombine( hash, reinterpret_cast<uint64_t>( b.pImmutableSamplers[i] ) );
+            }
+            hash = hashCombine( hash, 1 );
+        }
+        b.pImmutableSamplers = nullptr;
+    }
+
+    auto sameAs = [&key]( const CachedLayout& other )
+    {
+        if( other.flags != key.flags || other.bindings.size() != key.bindings.size() || other.immutableSamplers != key.immutableSamplers )
+            return false;
+        for( size_t i = 0; i < key.bindings.size(); ++i )
+        {
+            const auto& a = key.bindings[i];
+            const auto& b = other.bindings[i];
+            if( a.binding != b.binding || a.descriptorType != b.descriptorType || a.descriptorCount != b.descriptorCount ||
+                a.stageFlags != b.stageFlags )
+                return false;
+        }
+        return true;
+    };
+
+    std::lock_guard<std::mutex> lock( mutex_ );
+
+    auto& entries = layouts_[hash];
+    for( const auto& entry : entries )
+    {
+        if( sameAs( entry ) )
+            return entry.layout;
+    }
+
+    VK_CHECK( vkCreateDescriptorSetLayout( device_, &info, nullptr, &key.layout ) );
+
+    Counts counts{};
+    for( const auto& b : key.bindings )
+    {
+        const uint32_t type = static_cast<uint32_t>( b.descriptorType );
+        if( type < kTypeCount )
+        {
+            counts[type] += b.descriptorCount;
+        }
+    }
+    layoutCounts_[key.layout] = counts;
+    ++layoutCount_;
+
+    entries.push_back( std::move( key ) );
+    return entries.back().layout;
+}
+
+VkDescriptorSetLayout DescriptorAllocator::layout( std::initializer_list<VkDescriptorType> types, VkShaderStageFlags stages )
+{
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+    bindings.reserve( types.size() );
+    for( auto type : types )
+    {
+        VkDescriptorSetLayoutBinding b{};
+        b.binding         = static_cast<uint32_t>( bindings.size() );
+        b.descriptorType  = type;
+        b.descriptorCount = 1;
+        b.stageFlags      = stages;
+        bindings.push_back( b );
+    }
+
+    VkDescriptorSetLayoutCreateInfo info{};
+    info.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    info.bindingCount = static_cast<uint32_t>( bindings.size() );
+    info.pBindings    = bindings.data();
+    return layout( info );
+}
+
+VkDescriptorSet DescriptorAllocator::allocate( VkDescriptorSetLayout layout )
+{
+    std::lock_guard<std::mutex> lock( mutex_ );
+    return allocateFrom( persistent_, layout );
+}
+
+VkDescriptorSet DescriptorAllocator::allocateTransient( VkDescriptorSetLayout layout )
+{
+    std::lock_guard<std::mutex> lock( mutex_ );
+    return allocateFrom( frames_[frameSlot_], layout );
+}
+
+void DescriptorAllocator::beginFrame( uint32_t frameSlot )
+{
+    std::lock_guard<std::mutex> lock( mutex_ );
+
+    frameSlot_     = frameSlot;
+    PoolList& list = frames_[frameSlot];
+
+    if( list.current != VK_NULL_HANDLE )
+    {
+        list.full.push_back( list.current );
+        list.current = VK_NULL_HANDLE;
+    }
+    for( auto pool : list.full )
+    {
+        VK_CHECK( vkResetDescriptorPool( device_, pool, 0 ) );
+        list.ready.push_back( pool );
+    }
+    list.full.clear();
+}
+
+VkDescriptorSet DescriptorAllocator::allocateFrom( PoolList& list, VkDescriptorSetLayout layout )
+{
+    Counts counts{};
+    auto it = layoutCounts_.find( layout );
+    if( it != layoutCounts_.end() )
+    {
+        counts = it->second;
+    }
+    else
+    {
+        // Not from layout(); size by demand alone and hope the set fits. A failure below says so.
+        counts.fill( 0 );
+    }
+
+    for( uint32_t t = 0; t < kTypeCount; ++t )
+    {
+        demand_[t] += counts[t];
+    }
+    ++demandSets_;
+
+    VkDescriptorSetAllocateInfo ai{};
+    ai.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    ai.descriptorSetCount = 1;
+    ai.pSetLayouts        = &layout;
+
+    for( ;; )
+    {
+        bool fresh = false;
+        if( list.current == VK_NULL_HANDLE )
+        {
+            if( !list.ready.empty() )
+            {
+                list.current = list.ready.back();
+                list.ready.pop_back();
+            }
+            else
+            {
+                list.setsPerPool = list.setsPerPool == 0 ? kInitialSetsPerPool : std::min( list.setsPerPool * 2, kMaxSetsPerPool );
+                list.current     = createSizedPool( list.setsPerPool, counts );
+                fresh            = true;
+            }
+        }
+
+        ai.descriptorPool   = list.current;
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        const VkResult res  = vkAllocateDescriptorSets( device_, &ai, &set );
+        if( res == VK_SUCCESS )
+            return set;
+
+        if( res != VK_ERROR_OUT_OF_POOL_MEMORY && res != VK_ERROR_FRAGMENTED_POOL )
+        {
+            VK_CHECK( res );
+        }
+
+        list.full.push_back( list.current );
+        list.current = VK_NULL_HANDLE;
+        if( fresh )
+        {
+            std::fprintf( stderr, "DescriptorAllocator: set does not fit an empty pool (layout not created through layout()?).\n" );
+            return VK_NULL_HANDLE;
+        }
+    }
+}
+
+VkDescriptorPool DescriptorAllocator::createSizedPool( uint32_t maxSets, const Counts& minimum )
+{
+    std::vector<VkDescriptorPoolSize> sizes;
+    for( uint32_t t = 0; t < kTypeCount; ++t )
+    {
+        // Average descriptors of this type per set so far, times the sets the pool holds, rounded up.
+        const uint64_t share = demandSets_ == 0 ? 0 : ( demand_[t] * maxSets + demandSets_ - 1 ) / demandSets_;
+        const uint32_t count = static_cast<uint32_t>( std::max<uint64_t>( share, minimum[t] ) );
+        if( count > 0 )
+        {
+            sizes.push_back( { static_cast<VkDescriptorType>( t ), count } );
+        }
+    }
+
+    // A pool needs at least one size; demand-less sets (no descriptors at all) are legal.
+    if( sizes.empty() )
+    {
+        sizes.push_back( { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 } );
+    }
+
+    VkDescriptorPoolCreateInfo ci{};
+    ci.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    ci.maxSets       = maxSets;
+    ci.poolSizeCount = static_cast<uint32_t>( sizes.size() );
+    ci.pPoolSizes    = sizes.data();
+
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    VK_CHECK( vkCreateDescriptorPool( device_, &ci, nullptr, &pool ) );
+    return pool;
+}
+
+VkDescriptorPool DescriptorAllocator::createPool( const std::vector<VkDescriptorPoolSize>& sizes, uint32_t maxSets,
+                                                  VkDescriptorPoolCreateFlags flags )
+{
+    VkDescriptorPoolCreateInfo ci{};
+    ci.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    ci.flags         = flags;
+    ci.maxSets       = maxSets;
+    ci.poolSizeCount = static_cast<uint32_t>( sizes.size() );
+    ci.pPoolSizes    = sizes.data();
+
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    VK_CHECK( vkCreateDescriptorPool( device_, &ci, nullptr, &pool ) );
+
+    std::lock_guard<std::mutex> lock( mutex_ );
+    standalone_.push_back( pool );
+    return pool;
+}
+
+uint32_t DescriptorAllocator::poolCount() const
+{
+    std::lock_guard<std::mutex> lock( mutex_ );
+
+    auto listCount = []( const PoolList& list )
+    { return static_cast<uint32_t>( ( list.current != VK_NULL_HANDLE ? 1 : 0 ) + list.full.size() + list.ready.size() ); };
+
+    uint32_t count = listCount( persistent_ ) + static_cast<uint32_t>( standalone_.size() );
+    for( const auto& list : frames_ )
+    {
+        count += listCount( list );
+    }
+    return count;
+}
+
+uint32_t DescriptorAllocator::layoutCount() const
+{
+    std::lock_guard<std::mutex> lock( mutex_ );
+    return layoutCount_;
+}
@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <cstring>
+#include <vk_renderer/device_caps.hpp>
+#include <vk_renderer/vulkan_functions.hpp>
+
+void ExtensionSet::assign( const std::vector<VkExtensionProperties>& extensions )
+{
+    names_.clear();
+    names_.reserve( extensions.size() );
+    for( const auto& e : extensions )
+    {
+        names_.emplace_back( e.extensionName );
+    }
+    std::sort( names_.begin(), names_.end() );
+}
+
+bool ExtensionSet::contains( const char* name ) const
+{
+    auto it = std::lower_bound( names_.begin(), names_.end(), name,
+                                []( const std::string& a, const char* b ) { return std::strcmp( a.c_str(), b ) < 0; } );
+    return it != names_.end() && *it == name;
+}
+
+const ExtensionSet& instanceExtensions()
+{
+    static const ExtensionSet set = []
+    {
+        // May run before any renderer init, which is what loads the library in dynamic builds.
+        if( !loadVulkanLibrary() )
+            return ExtensionSet{};
+
+        uint32_t count = 0;
+        vkEnumerateInstanceExtensionProperties( nullptr, &count, nullptr );
+        std::vector<VkExtensionProperties> exts( count );
+        vkEnumerateInstanceExtensionProperties( nullptr, &count, exts.data() );
+        exts.resize( count );
+
+        ExtensionSet s;
+        s.assign( exts );
+        return s;
+    }();
+    return set;
+}
+
+DeviceCaps DeviceCaps::query( VkPhysicalDevice physicalDevice, uint32_t index )
+{
+    DeviceCaps caps;
+    caps.physicalDevice = physicalDevice;
+    caps.index          = index;
+
+    vkGetPhysicalDeviceProperties( physicalDevice, &caps.properties );
+    vkGetPhysicalDeviceMemoryProperties( physicalDevice, &caps.memory );
+
+    uint32_t qCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties( physicalDevice, &qCount, nullptr );
+    caps.queueFamilies.resize( qCount );
+    vkGetPhysicalDeviceQueueFamilyProperties( physicalDevice, &qCount, caps.queueFamilies.data() );
+
+    uint32_t extCount = 0;
+    vkEnumerateDeviceExtensionProperties( physicalDevice, nullptr, &extCount, nullptr );
+    std::vector<VkExtensionProperties> exts( extCount );
+    vkEnumerateDeviceExtensionProperties( physicalDevice, nullptr, &extCount, exts.data() );
+    exts.resize( extCount );
+    caps.extensions.assign( exts );
+
+    caps.dynamicRendering.sType         = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    caps.timelineSemaphore.sType        = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+    caps.descriptorIndexing.sType       = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    caps.descriptorIndexingLimits.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+    caps.ids.sType                      = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+    // Extension structs are only chained when the extension exists; the *2 queries need 1.1.
+    if( caps.properties.apiVersion >= VK_API_VERSION_1_1 )
+    {
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+
+        VkPhysicalDeviceProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &caps.ids;
+        if( caps.hasExtension( VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME ) )
+        {
+            caps.dynamicRendering.pNext = features2.pNext;
+            features2.pNext             = &caps.dynamicRendering;
+        }
+        if( caps.hasExtension( VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME ) )
+        {
+            caps.timelineSemaphore.pNext = features2.pNext;
+            features2.pNext              = &caps.timelineSemaphore;
+        }
+        if( caps.hasExtension( VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME ) )
+        {
+            caps.descriptorIndexing.pNext = features2.pNext;
+            features2.pNext               = &caps.descriptorIndexing;
+
+            caps.descriptorIndexingLimits.pNext = properties2.pNext;
+            properties2.pNext                   = &caps.descriptorIndexingLimits;
+        }
+        vkGetPhysicalDeviceFeatures2( physicalDevice, &features2 );
+        vkGetPhysicalDeviceProperties2( physicalDevice, &properties2 );
+
+        caps.features                       = features2.features;
+        caps.dynamicRendering.pNext         = nullptr;
+        caps.timelineSemaphore.pNext        = nullptr;
+        caps.descriptorIndexing.pNext       = nullptr;
+        caps.descriptorIndexingLimits.pNext = nullptr;
+        caps.ids.pNext                      = nullptr;
+    }
+    else
+    {
+        vkGetPhysicalDeviceFeatures( physicalDevice, &caps.features );
+    }
+
+    return caps;
+}
+
+VkDeviceSize DeviceCaps::deviceLocalBytes() const
+{
+    VkDeviceSize bytes = 0;
+    for( uint32_t i = 0; i < memory.memoryHeapCount; ++i )
+    {
+        if( memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT )
+            bytes += memory.memoryHeaps[i].size;
+    }
+    return bytes;
+}
+
+bool DeviceCaps::supportsFeatures( const VkPhysicalDeviceFeatures& required ) const
+{
+    // VkPhysicalDeviceFeatures is nothing but VkBool32 members.
+    constexpr size_t kCount = sizeof( VkPhysicalDeviceFeatures ) / sizeof( VkBool32 );
+
+    VkBool32 want[kCount];
+    VkBool32 have[kCount];
+    std::memcpy( want, &required, sizeof( want ) );
+    std::memcpy( have, &features, sizeof( have ) );
+
+    for( size_t i = 0; i < kCount; ++i )
+    {
+        if( want[i] && !have[i] )
+            return false;
+    }
+    return true;
+}
+
+uint64_t scoreDevice( const DeviceCaps& caps )
+{
+    uint64_t typeRank = 0;
+    switch( caps.properties.deviceType )
+    {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+            typeRank = 4;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+            typeRank = 3;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+            typeRank = 2;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:
+            typeRank = 1;
+            break;
+        default:
+            break;
+    }
+
+    // Type dominates; memory in MiB (well below 2^40) breaks ties within a type.
+    return ( typeRank << 40 ) | ( caps.deviceLocalBytes() >> 20 );
+}
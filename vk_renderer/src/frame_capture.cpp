@@ -0,0 +1,180 @@
+#include "vk_check.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+#include <vk_renderer/frame_capture.hpp>
+
+FrameCapture::~FrameCapture()
+{
+    destroy();
+}
+
+void FrameCapture::create( VkDevice device, const DeviceDispatch& vk, GpuAllocator& allocator, uint32_t slotCount )
+{
+    device_    = device;
+    vk_        = &vk;
+    allocator_ = &allocator;
+    slots_.resize( slotCount );
+}
+
+void FrameCapture::destroy()
+{
+    if( device_ == VK_NULL_HANDLE )
+        return;
+
+    // Callers idle the device (and deliver what they still want) first.
+    for( auto& slot : slots_ )
+    {
+        if( slot.buffer != VK_NULL_HANDLE )
+        {
+            allocator_->destroyBuffer( slot.buffer, slot.allocation );
+        }
+    }
+    slots_.clear();
+    pending_.clear();
+    device_ = VK_NULL_HANDLE;
+}
+
+uint32_t FrameCapture::texelSize( VkFormat format )
+{
+    switch( format )
+    {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+        case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+            return 4;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+void FrameCapture::record( VkCommandBuffer cmd, VkImage image, VkImageLayout layout, VkExtent2D extent, VkFormat format, uint64_t frame )
+{
+    if( pending_.empty() )
+        return;
+
+    Slot* slot = nullptr;
+    for( auto& s : slots_ )
+    {
+        if( !s.busy )
+        {
+            slot = &s;
+            break;
+        }
+    }
+    if( slot == nullptr )
+        return; // retried next frame
+
+    const uint32_t texel = texelSize( format );
+    if( texel == 0 )
+    {
+        std::fprintf( stderr, "Capture of format %d is not supported; dropping %zu request(s).\n", (int)format, pending_.size() );
+        pending_.clear();
+        return;
+    }
+    const VkDeviceSize size = VkDeviceSize( extent.width ) * extent.height * texel;
+
+    // The slot is idle, so its buffer can be replaced right away.
+    if( slot->capacity < size )
+    {
+        if( slot->buffer != VK_NULL_HANDLE )
+        {
+            allocator_->destroyBuffer( slot->buffer, slot->allocation );
+        }
+
+        VkBufferCreateInfo bci{};
+        bci.sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bci.size        = size;
+        bci.usage       = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        slot->buffer   = allocator_->createBuffer( bci, GpuMemoryUsage::GpuToCpu, &slot->allocation );
+        slot->capacity = size;
+        if( slot->buffer == VK_NULL_HANDLE || !slot->allocation->mapped )
+        {
+            std::fprintf( stderr, "Failed to allocate a %llu byte capture buffer.\n", (unsigned long long)size );
+            std::abort();
+        }
+    }
+
+    VkImageMemoryBarrier toSrc{};
+    toSrc.sType                       = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    toSrc.srcAccessMask               = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    toSrc.dstAccessMask               = VK_ACCESS_TRANSFER_READ_BIT;
+    toSrc.oldLayout                   = layout;
+    toSrc.newLayout                   = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    toSrc.srcQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
+    toSrc.dstQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
+    toSrc.image                       = image;
+    toSrc.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    toSrc.subresourceRange.levelCount = 1;
+    toSrc.subresourceRange.layerCount = 1;
+    vk_->vkCmdPipelineBarrier( cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                               nullptr, 1, &toSrc );
+
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent                 = { extent.width, extent.height, 1 };
+    vk_->vkCmdCopyImageToBuffer( cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer, 1, &region );
+
+    if( layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL )
+    {
+        VkImageMemoryBarrier back = toSrc;
+        back.srcAccessMask        = 0; // the copy only read the image
+        back.dstAccessMask        = 0;
+        back.oldLayout            = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        back.newLayout            = layout;
+        vk_->vkCmdPipelineBarrier( cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1,
+                                   &back );
+    }
+
+    VkBufferMemoryBarrier toHost{};
+    toHost.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    toHost.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toHost.dstAccessMask       = VK_ACCESS_HOST_READ_BIT;
+    toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toHost.buffer              = slot->buffer;
+    toHost.size                = size;
+    vk_->vkCmdPipelineBarrier( cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &toHost, 0, nullptr );
+
+    slot->busy          = true;
+    slot->info.frame    = frame;
+    slot->info.width    = extent.width;
+    slot->info.height   = extent.height;
+    slot->info.format   = format;
+    slot->info.rowPitch = extent.width * texel;
+    slot->callbacks     = std::move( pending_ );
+    pending_.clear();
+}
+
+void FrameCapture::deliver( uint64_t completedFrames )
+{
+    for( auto& slot : slots_ )
+    {
+        if( !slot.busy || slot.info.frame > completedFrames )
+            continue;
+
+        const VkDeviceSize size = VkDeviceSize( slot.info.rowPitch ) * slot.info.height;
+        allocator_->invalidate( slot.allocation, 0, size );
+
+        CapturedFrame captured = slot.info;
+        captured.pixels        = slot.allocation->mapped;
+
+        // Callbacks may request further captures; those go to pending_, not to this slot.
+        std::vector<CaptureCallback> callbacks = std::move( slot.callbacks );
+        slot.callbacks.clear();
+        for( auto& callback : callbacks )
+        {
+            callback( captured );
+        }
+        slot.busy = false;
+    }
+}
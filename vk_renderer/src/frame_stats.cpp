@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <cmath>
+#include <vk_renderer/frame_stats.hpp>
+
+const char* framePhaseName( FramePhase phase )
+{
+    switch( phase )
+    {
+        case FramePhase::FenceWait:
+            return "fence_wait";
+        case FramePhase::Acquire:
+            return "acquire";
+        case FramePhase::Record:
+            return "record";
+        case FramePhase::Submit:
+            return "submit";
+        case FramePhase::Present:
+            return "present";
+        case FramePhase::Recreate:
+            return "recreate";
+        case FramePhase::CpuTotal:
+            return "cpu_total";
+        case FramePhase::Gpu:
+            return "gpu";
+        default:
+            return "unknown";
+    }
+}
+
+void FrameTimingRing::push( const FrameTiming& timing )
+{
+    const uint64_t index = head_.load( std::memory_order_relaxed );
+    Slot& slot           = slots_[index % kCapacity];
+
+    // Sequence 2i+1 marks slot i as being written, 2i+2 as holding push i.
+    slot.seq.store( 2 * index + 1, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+
+    slot.frame.store( timing.frame, std::memory_order_relaxed );
+    for( size_t p = 0; p < kFramePhaseCount; ++p )
+    {
+        slot.ms[p].store( timing.ms[p], std::memory_order_relaxed );
+    }
+
+    slot.seq.store( 2 * index + 2, std::memory_order_release );
+    head_.store( index + 1, std::memory_order_release );
+}
+
+size_t FrameTimingRing::snapshot( std::vector<FrameTiming>& out ) const
+{
+    out.clear();
+
+    const uint64_t head  = head_.load( std::memory_order_acquire );
+    const uint64_t first = head > kCapacity ? head - kCapacity : 0;
+    out.reserve( static_cast<size_t>( head - first ) );
+
+    for( uint64_t index = first; index < head; ++index )
+    {
+        const Slot& slot       = slots_[index % kCapacity];
+        const uint64_t expects = 2 * index + 2;
+
+        if( slot.seq.load( std::memory_order_acquire ) != expects )
+            continue; // being overwritten by a newer push
+
+        FrameTiming timing;
+        timing.frame = slot.frame.load( std::memory_order_relaxed );
+        for( size_t p = 0; p < kFramePhaseCount; ++p )
+        {
+            timing.ms[p] = slot.ms[p].load( std::memory_order_relaxed );
+        }
+
+        std::atomic_thread_fence( std::memory_order_acquire );
+        if( slot.seq.load( std::memory_order_relaxed ) != expects )
+            continue; // torn read
+
+        out.push_back( timing );
+    }
+
+    return out.size();
+}
+
+FrameStats FrameTimingRing::summarize() const
+{
+    std::vector<FrameTiming> timings;
+    snapshot( timings );
+
+    FrameStats stats;
+    stats.frames = static_cast<uint32_t>( timings.size() );
+
+    std::vector<double> values;
+    values.reserve( timings.size() );
+
+    for( size_t p = 0; p < kFramePhaseCount; ++p )
+    {
+        values.clear();
+        for( const auto& t : timings )
+        {
+            if( t.ms[p] >= 0.0 )
+                values.push_back( t.ms[p] );
+        }
+
+        if( values.empty() )
+            continue;
+
+        std::sort( values.begin(), values.end() );
+
+        double sum = 0.0;
+        for( double v : values )
+        {
+            sum += v;
+        }
+
+        // Nearest-rank percentile.
+        const size_t p99Index = static_cast<size_t>( std::ceil( 0.99 * static_cast<double>( values.size() ) ) ) - 1;
+
+        PhaseStats& ps = stats.phases[p];
+        ps.samples     = static_cast<uint32_t>( values.size() );
+        ps.minMs       = values.front();
+        ps.maxMs       = values.back();
+        ps.avgMs       = sum / static_cast<double>( values.size() );
+        ps.p99Ms       = values[p99Index];
+    }
+
+    return stats;
+}
+
+void FrameTimingRing::clear()
+{
+    // Not safe against a concurrent push; only used while the renderer is shut down.
+    for( auto& slot : slots_ )
+    {
+        slot.seq.store( 0, std::memory_order_relaxed );
+    }
+    head_.store( 0, std::memory_order_release );
+}
@@ -0,0 +1,609 @@
+#include "vk_check.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <utility>
+#include <vk_renderer/gpu_allocator.hpp>
+
+// One VkDeviceMemory carved into allocations. Free ranges are kept coalesced: no two are adjacent.
+struct GpuMemoryBlock
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size     = 0;
+    VkDeviceSize used     = 0;
+    void* mapped          = nullptr;
+    uint32_t memoryType   = 0;
+    GpuResourceKind kind  = GpuResourceKind::Linear;
+
+    std::map<VkDeviceSize, VkDeviceSize> freeByOffset;    // offset -> size
+    std::multimap<VkDeviceSize, VkDeviceSize> freeBySize; // size -> offset
+    std::vector<std::unique_ptr<GpuAllocation>> allocations;
+
+    VkDeviceSize largestFree() const { return freeBySize.empty() ? 0 : freeBySize.rbegin()->first; }
+
+    void insertFree( VkDeviceSize offset, VkDeviceSize rangeSize )
+    {
+        freeByOffset.emplace( offset, rangeSize );
+        freeBySize.emplace( rangeSize, offset );
+    }
+
+    std::map<VkDeviceSize, VkDeviceSize>::iterator eraseFree( std::map<VkDeviceSize, VkDeviceSize>::iterator it )
+    {
+        auto [first, last] = freeBySize.equal_range( it->second );
+        for( auto s = first; s != last; ++s )
+        {
+            if( s->second == it->first )
+            {
+                freeBySize.erase( s );
+                break;
+            }
+        }
+        return freeByOffset.erase( it );
+    }
+
+    // Best fit: the smallest free range that still holds the request after aligning its start.
+    bool allocate( VkDeviceSize allocSize, VkDeviceSize alignment, VkDeviceSize& offset )
+    {
+        for( auto it = freeBySize.lower_bound( allocSize ); it != freeBySize.end(); ++it )
+        {
+            const VkDeviceSize start     = it->second;
+            const VkDeviceSize end       = start + it->first;
+            const VkDeviceSize alignedAt = ( start + alignment - 1 ) / alignment * alignment;
+            if( alignedAt + allocSize > end )
+                continue;
+
+            freeBySize.erase( it );
+            freeByOffset.erase( start );
+            if( alignedAt > start )
+                insertFree( start, alignedAt - start );
+            if( alignedAt + allocSize < end )
+                insertFree( alignedAt + allocSize, end - alignedAt - allocSize );
+
+            used += allocSize;
+            offset = alignedAt;
+            return true;
+        }
+        return false;
+    }
+
+    void release( VkDeviceSize offset, VkDeviceSize rangeSize )
+    {
+        used -= rangeSize;
+
+        auto next = freeByOffset.lower_bound( offset );
+        if( next != freeByOffset.end() && next->first == offset + rangeSize )
+        {
+            rangeSize += next->second;
+            next = eraseFree( next );
+        }
+        if( next != freeByOffset.begin() )
+        {
+            auto prev = std::prev( next );
+            if( prev->first + prev->second == offset )
+            {
+                offset = prev->first;
+                rangeSize += prev->second;
+                eraseFree( prev );
+            }
+        }
+
+        insertFree( offset, rangeSize );
+    }
+};
+
+static constexpr VkDeviceSize kDefaultBlockSize = 64ull * 1024 * 1024;
+static constexpr VkDeviceSize kSmallHeapSize    = 1024ull * 1024 * 1024;
+
+// Out of line because Pool holds unique_ptrs to a type that is only complete here.
+GpuAllocator::GpuAllocator() = default;
+
+GpuAllocator::~GpuAllocator()
+{
+    destroy();
+}
+
+void GpuAllocator::create( const DeviceCaps& caps, VkDevice device, VkDeviceSize blockSize )
+{
+    device_          = device;
+    blockSize_       = blockSize;
+    memoryProps_     = caps.memory;
+    nonCoherentAtom_ = std::max<VkDeviceSize>( 1, caps.properties.limits.nonCoherentAtomSize );
+    maxMemoryCount_  = caps.properties.limits.maxMemoryAllocationCount;
+
+    pools_.resize( memoryProps_.memoryTypeCount * 2 );
+}
+
+void GpuAllocator::destroy()
+{
+    std::lock_guard<std::mutex> lock( mutex_ );
+
+    uint32_t leaked = static_cast<uint32_t>( dedicated_.size() );
+    for( auto& pool : pools_ )
+    {
+        for( auto& block : pool )
+        {
+            leaked += static_cast<uint32_t>( block->allocations.size() );
+            vkFreeMemory( device_, block->memory, nullptr );
+        }
+    }
+    for( auto& allocation : dedicated_ )
+    {
+        vkFreeMemory( device_, allocation->memory, nullptr );
+    }
+
+    if( leaked > 0 )
+    {
+        std::fprintf( stderr, "GpuAllocator destroyed with %u live allocations.\n", leaked );
+    }
+
+    pools_.clear();
+    dedicated_.clear();
+    device_ = VK_NULL_HANDLE;
+}
+
+bool GpuAllocator::findMemoryType( uint32_t typeBits, GpuMemoryUsage usage, uint32_t& typeIndex ) const
+{
+    // Candidate property sets, most desirable first.
+    VkMemoryPropertyFlags candidates[2] = {};
+    switch( usage )
+    {
+        case GpuMemoryUsage::GpuOnly:
+            candidates[0] = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            candidates[1] = 0;
+            break;
+        case GpuMemoryUsage::CpuToGpu:
+            candidates[0] = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            candidates[1] = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            break;
+        case GpuMemoryUsage::GpuToCpu:
+            candidates[0] = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+            candidates[1] = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            break;
+    }
+
+    for( VkMemoryPropertyFlags wanted : candidates )
+    {
+        for( uint32_t i = 0; i < memoryProps_.memoryTypeCount; ++i )
+        {
+            if( ( typeBits & ( 1u << i ) ) && ( memoryProps_.memoryTypes[i].propertyFlags & wanted ) == wanted )
+            {
+                typeIndex = i;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+VkDeviceSize GpuAllocator::blockSizeFor( uint32_t typeIndex ) const
+{
+    if( blockSize_ != 0 )
+        return blockSize_;
+
+    const VkDeviceSize heapSize = memoryProps_.memoryHeaps[memoryProps_.memoryTypes[typeIndex].heapIndex].size;
+    return heapSize <= kSmallHeapSize ? heapSize / 8 : kDefaultBlockSize;
+}
+
+GpuAllocator::Pool& GpuAllocator::poolFor( uint32_t typeIndex, GpuResourceKind kind )
+{
+    return pools_[typeIndex * 2 + ( kind == GpuResourceKind::Optimal ? 1 : 0 )];
+}
+
+GpuAllocation* GpuAllocator::allocate( const VkMemoryRequirements& req, GpuMemoryUsage usage, GpuResourceKind kind, bool dedicated )
+{
+    return allocateMemory( req, usage, kind, dedicated, nullptr );
+}
+
+GpuAllocation* GpuAllocator::allocateMemory( const VkMemoryRequirements& req, GpuMemoryUsage usage, GpuResourceKind kind,
+                                             bool dedicated, const VkMemoryDedicatedAllocateInfo* dedicatedInfo )
+{
+    if( req.size == 0 )
+        return nullptr;
+
+    uint32_t typeIndex = 0;
+    if( !findMemoryType( req.memoryTypeBits, usage, typeIndex ) )
+    {
+        std::fprintf( stderr, "No memory type for usage %d in type bits 0x%x.\n", (int)usage, req.memoryTypeBits );
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock( mutex_ );
+
+    if( dedicated || req.size > blockSizeFor( typeIndex ) / 2 )
+        return allocateDedicated( req.size, typeIndex, dedicatedInfo );
+
+    GpuAllocation* allocation = allocateFromPool( req, typeIndex, kind );
+    if( !allocation )
+    {
+        // No room for another block, but an exact-size allocation may still fit in the heap.
+        allocation = allocateDedicated( req.size, typeIndex, dedicatedInfo );
+    }
+    return allocation;
+}
+
+GpuAllocation* GpuAllocator::allocateDedicated( VkDeviceSize size, uint32_t typeIndex, const VkMemoryDedicatedAllocateInfo* dedicatedInfo )
+{
+    VkMemoryAllocateInfo mai{};
+    mai.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    mai.pNext           = dedicatedInfo;
+    mai.allocationSize  = size;
+    mai.memoryTypeIndex = typeIndex;
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    if( vkAllocateMemory( device_, &mai, nullptr, &memory ) != VK_SUCCESS )
+        return nullptr;
+
+    void* mapped = nullptr;
+    if( memoryProps_.memoryTypes[typeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT )
+    {
+        VK_CHECK( vkMapMemory( device_, memory, 0, VK_WHOLE_SIZE, 0, &mapped ) );
+    }
+
+    auto allocation        = std::make_unique<GpuAllocation>();
+    allocation->memory     = memory;
+    allocation->size       = size;
+    allocation->mapped     = mapped;
+    allocation->memoryType = typeIndex;
+    allocation->dedicated  = true;
+    allocation->slot_      = dedicated_.size();
+
+    dedicated_.push_back( std::move( allocation ) );
+    return dedicated_.back().get();
+}
+
+GpuAllocation* GpuAllocator::allocateFromPool( const VkMemoryRequirements& req, uint32_t typeIndex, GpuResourceKind kind )
+{
+    const VkDeviceSize alignment = std::max<VkDeviceSize>( 1, req.alignment );
+    Pool& pool                   = poolFor( typeIndex, kind );
+
+    auto allocation        = std::make_unique<GpuAllocation>();
+    allocation->size       = req.size;
+    allocation->alignment_ = alignment;
+
+    VkDeviceSize offset = 0;
+    for( auto& block : pool )
+    {
+        if( block->largestFree() >= req.size && block->allocate( req.size, alignment, offset ) )
+            return attach( std::move( allocation ), block.get(), offset );
+    }
+
+    GpuMemoryBlock* block = createBlock( pool, req.size, typeIndex, kind );
+    if( !block || !block->allocate( req.size, alignment, offset ) )
+        return nullptr;
+
+    return attach( std::move( allocation ), block, offset );
+}
+
+GpuMemoryBlock* GpuAllocator::createBlock( Pool& pool, VkDeviceSize minSize, uint32_t typeIndex, GpuResourceKind kind )
+{
+    VkDeviceSize size = std::max( blockSizeFor( typeIndex ), minSize );
+
+    VkMemoryAllocateInfo mai{};
+    mai.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    mai.memoryTypeIndex = typeIndex;
+
+    // Halve the block on failure, so a nearly full heap still yields a smaller block.
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    for( ;; )
+    {
+        mai.allocationSize = size;
+        if( vkAllocateMemory( device_, &mai, nullptr, &memory ) == VK_SUCCESS )
+            break;
+        if( size / 2 < minSize )
+            return nullptr;
+        size /= 2;
+    }
+
+    auto block        = std::make_unique<GpuMemoryBlock>();
+    block->memory     = memory;
+    block->size       = size;
+    block->memoryType = typeIndex;
+    block->kind       = kind;
+    block->insertFree( 0, size );
+
+    if( memoryProps_.memoryTypes[typeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT )
+    {
+        VK_CHECK( vkMapMemory( device_, memory, 0, VK_WHOLE_SIZE, 0, &block->mapped ) );
+    }
+
+    pool.push_back( std::move( block ) );
+    return pool.back().get();
+}
+
+void GpuAllocator::releaseEmptyBlocks( Pool& pool, bool keepSpare )
+{
+    // Keeping one empty block avoids a vkAllocateMemory/vkFreeMemory pair when usage hovers at a block boundary.
+    bool spareKept = !keepSpare;
+    for( auto it = pool.begin(); it != pool.end(); )
+    {
+        if( ( *it )->allocations.empty() && spareKept )
+        {
+            vkFreeMemory( device_, ( *it )->memory, nullptr );
+            it = pool.erase( it );
+            continue;
+        }
+        if( ( *it )->allocations.empty() )
+        {
+            spareKept = true;
+        }
+        ++it;
+    }
+}
+
+GpuAllocation* GpuAllocator::attach( std::unique_ptr<GpuAllocation> allocation, GpuMemoryBlock* block, VkDeviceSize offset )
+{
+    allocation->memory     = block->memory;
+    allocation->offset     = offset;
+    allocation->mapped     = block->mapped ? static_cast<char*>( block->mapped ) + offset : nullptr;
+    allocation->memoryType = block->memoryType;
+    allocation->dedicated  = false;
+    allocation->block_     = block;
+    allocation->slot_      = block->allocations.size();
+
+    block->allocations.push_back( std::move( allocation ) );
+    return block->allocations.back().get();
+}
+
+std::unique_ptr<GpuAllocation> GpuAllocator::detach( GpuAllocation* allocation )
+{
+    GpuMemoryBlock* block = allocation->block_;
+    block->release( allocation->offset, allocation->size );
+
+    auto& slots                          = block->allocations;
+    std::unique_ptr<GpuAllocation> owned = std::move( slots[allocation->slot_] );
+    if( allocation->slot_ != slots.size() - 1 )
+    {
+        slots[allocation->slot_]        = std::move( slots.back() );
+        slots[allocation->slot_]->slot_ = allocation->slot_;
+    }
+    slots.pop_back();
+
+    owned->block_ = nullptr;
+    return owned;
+}
+
+void GpuAllocator::free( GpuAllocation* allocation )
+{
+    if( !allocation )
+        return;
+
+    std::lock_guard<std::mutex> lock( mutex_ );
+
+    if( allocation->dedicated )
+    {
+        vkFreeMemory( device_, allocation->memory, nullptr );
+
+        const size_t slot = allocation->slot_;
+        if( slot != dedicated_.size() - 1 )
+        {
+            dedicated_[slot]        = std::move( dedicated_.back() );
+            dedicated_[slot]->slot_ = slot;
+        }
+        dedicated_.pop_back();
+        return;
+    }
+
+    GpuMemoryBlock* block = allocation->block_;
+    detach( allocation );
+
+    if( block->allocations.empty() )
+    {
+        releaseEmptyBlocks( poolFor( block->memoryType, block->kind ), true );
+    }
+}
+
+VkBuffer GpuAllocator::createBuffer( const VkBufferCreateInfo& info, GpuMemoryUsage usage, GpuAllocation** allocation )
+{
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VK_CHECK( vkCreateBuffer( device_, &info, nullptr, &buffer ) );
+
+    VkBufferMemoryRequirementsInfo2 reqInfo{};
+    reqInfo.sType  = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+    reqInfo.buffer = buffer;
+
+    VkMemoryDedicatedRequirements dedicatedReq{};
+    dedicatedReq.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+    VkMemoryRequirements2 req{};
+    req.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    req.pNext = &dedicatedReq;
+    vkGetBufferMemoryRequirements2( device_, &reqInfo, &req );
+
+    VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+    dedicatedInfo.sType  = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+    dedicatedInfo.buffer = buffer;
+
+    *allocation = allocateMemory( req.memoryRequirements, usage, GpuResourceKind::Linear, dedicatedReq.prefersDedicatedAllocation == VK_TRUE,
+                                  &dedicatedInfo );
+    if( !*allocation )
+    {
+        vkDestroyBuffer( device_, buffer, nullptr );
+        return VK_NULL_HANDLE;
+    }
+
+    VK_CHECK( vkBindBufferMemory( device_, buffer, ( *allocation )->memory, ( *allocation )->offset ) );
+    return buffer;
+}
+
+VkImage GpuAllocator::createImage( const VkImageCreateInfo& info, GpuMemoryUsage usage, GpuAllocation** allocation, bool dedicated )
+{
+    VkImage image = VK_NULL_HANDLE;
+    VK_CHECK( vkCreateImage( device_, &info, nullptr, &image ) );
+
+    VkImageMemoryRequirementsInfo2 reqInfo{};
+    reqInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+    reqInfo.image = image;
+
+    VkMemoryDedicatedRequirements dedicatedReq{};
+    dedicatedReq.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+    VkMemoryRequirements2 req{};
+    req.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    req.pNext = &dedicatedReq;
+    vkGetImageMemoryRequirements2( device_, &reqInfo, &req );
+
+    VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+    dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+    dedicatedInfo.image = image;
+
+    const GpuResourceKind kind = info.tiling == VK_IMAGE_TILING_OPTIMAL ? GpuResourceKind::Optimal : GpuResourceKind::Linear;
+    *allocation                = allocateMemory( req.memoryRequirements, usage, kind,
+                                                 dedicated || dedicatedReq.prefersDedicatedAllocation == VK_TRUE, &dedicatedInfo );
+    if( !*allocation )
+    {
+        vkDestroyImage( device_, image, nullptr );
+        return VK_NULL_HANDLE;
+    }
+
+    VK_CHECK( vkBindImageMemory( device_, image, ( *allocation )->memory, ( *allocation )->offset ) );
+    return image;
+}
+
+void GpuAllocator::destroyBuffer( VkBuffer buffer, GpuAllocation* allocation )
+{
+    if( buffer != VK_NULL_HANDLE )
+    {
+        vkDestroyBuffer( device_, buffer, nullptr );
+    }
+    free( allocation );
+}
+
+void GpuAllocator::destroyImage( VkImage image, GpuAllocation* allocation )
+{
+    if( image != VK_NULL_HANDLE )
+    {
+        vkDestroyImage( device_, image, nullptr );
+    }
+    free( allocation );
+}
+
+bool GpuAllocator::mappedRange( const GpuAllocation* allocation, VkDeviceSize offset, VkDeviceSize size, VkMappedMemoryRange& range ) const
+{
+    if( !allocation || !allocation->mapped )
+        return false;
+    if( memoryProps_.memoryTypes[allocation->memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT )
+        return false;
+
+    if( size == VK_WHOLE_SIZE )
+    {
+        size = allocation->size - offset;
+    }
+
+    // Ranges must be nonCoherentAtomSize aligned; widening one only flushes or invalidates neighbouring bytes.
+    const VkDeviceSize memorySize = allocation->block_ ? allocation->block_->size : allocation->size;
+    const VkDeviceSize begin      = ( allocation->offset + offset ) / nonCoherentAtom_ * nonCoherentAtom_;
+    const VkDeviceSize end        = ( allocation->offset + offset + size + nonCoherentAtom_ - 1 ) / nonCoherentAtom_ * nonCoherentAtom_;
+
+    range        = {};
+    range.sType  = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = allocation->memory;
+    range.offset = begin;
+    range.size   = end >= memorySize ? VK_WHOLE_SIZE : end - begin;
+    return true;
+}
+
+void GpuAllocator::flush( const GpuAllocation* allocation, VkDeviceSize offset, VkDeviceSize size )
+{
+    VkMappedMemoryRange range;
+    if( mappedRange( allocation, offset, size, range ) )
+    {
+        VK_CHECK( vkFlushMappedMemoryRanges( device_, 1, &range ) );
+    }
+}
+
+void GpuAllocator::invalidate( const GpuAllocation* allocation, VkDeviceSize offset, VkDeviceSize size )
+{
+    VkMappedMemoryRange range;
+    if( mappedRange( allocation, offset, size, range ) )
+    {
+        VK_CHECK( vkInvalidateMappedMemoryRanges( device_, 1, &range ) );
+    }
+}
+
+uint32_t GpuAllocator::defragment( const MoveCallback& move, uint32_t maxMoves )
+{
+    std::lock_guard<std::mutex> lock( mutex_ );
+
+    uint32_t moves = 0;
+    for( auto& pool : pools_ )
+    {
+        if( pool.size() < 2 )
+            continue;
+
+        // Drain the emptiest blocks first, into the fullest ones.
+        std::vector<GpuMemoryBlock*> order;
+        order.reserve( pool.size() );
+        for( auto& block : pool )
+        {
+            order.push_back( block.get() );
+        }
+        std::sort( order.begin(), order.end(), []( const GpuMemoryBlock* a, const GpuMemoryBlock* b ) { return a->used < b->used; } );
+
+        for( size_t src = 0; src + 1 < order.size() && moves < maxMoves; ++src )
+        {
+            GpuMemoryBlock* from = order[src];
+
+            // Backwards, because detach() fills the vacated slot with the last allocation.
+            for( size_t i = from->allocations.size(); i-- > 0 && moves < maxMoves; )
+            {
+                GpuAllocation* allocation = from->allocations[i].get();
+
+                for( size_t dst = order.size() - 1; dst > src; --dst )
+                {
+                    GpuMemoryBlock* to  = order[dst];
+                    VkDeviceSize offset = 0;
+                    if( to->largestFree() < allocation->size || !to->allocate( allocation->size, allocation->alignment_, offset ) )
+                        continue;
+
+                    if( move( *allocation, to->memory, offset ) )
+                    {
+                        attach( detach( allocation ), to, offset );
+                        ++moves;
+                    }
+                    else
+                    {
+                        to->release( offset, allocation->size );
+                    }
+                    break;
+                }
+            }
+        }
+
+        releaseEmptyBlocks( pool, false );
+    }
+
+    return moves;
+}
+
+GpuAllocatorStats GpuAllocator::stats() const
+{
+    std::lock_guard<std::mutex> lock( mutex_ );
+
+    GpuAllocatorStats stats;
+    stats.maxMemoryCount = maxMemoryCount_;
+    stats.dedicatedCount = static_cast<uint32_t>( dedicated_.size() );
+
+    for( const auto& pool : pools_ )
+    {
+        for( const auto& block : pool )
+        {
+            ++stats.blockCount;
+            stats.allocationCount += static_cast<uint32_t>( block->allocations.size() );
+            stats.reservedBytes += block->size;
+            stats.usedBytes += block->used;
+            stats.largestFree = std::max( stats.largestFree, block->largestFree() );
+        }
+    }
+
+    for( const auto& allocation : dedicated_ )
+    {
+        stats.reservedBytes += allocation->size;
+        stats.usedBytes += allocation->size;
+    }
+
+    stats.allocationCount += stats.dedicatedCount;
+    stats.deviceMemoryCount = stats.blockCount + stats.dedicatedCount;
+    return stats;
+}
@@ -0,0 +1,235 @@
+#include "vk_check.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include <vk_renderer/pipeline_cache.hpp>
+
+#if defined( __unix__ ) || defined( __APPLE__ )
+#include <unistd.h>
+#endif
+
+struct PipelineCache::FileHeader
+{
+    uint32_t magic;
+    uint32_t fileVersion;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint32_t reserved;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    uint8_t deviceUUID[VK_UUID_SIZE];
+    uint8_t driverUUID[VK_UUID_SIZE];
+    uint64_t dataSize;
+    uint64_t dataHash;
+};
+
+static constexpr uint32_t kCacheMagic       = 0x43504b56; // "VKPC"
+static constexpr uint32_t kCacheFileVersion = 1;
+
+// FNV-1a; only guards against truncation and bit rot, not tampering.
+static uint64_t hashBytes( const uint8_t* data, size_t size )
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    for( size_t i = 0; i < size; ++i )
+    {
+        h ^= data[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+static bool readFile( const std::string& path, std::vector<uint8_t>& out )
+{
+    std::FILE* f = std::fopen( path.c_str(), "rb" );
+    if( !f )
+        return false;
+
+    std::fseek( f, 0, SEEK_END );
+    long size = std::ftell( f );
+    std::fseek( f, 0, SEEK_SET );
+
+    bool ok = size > 0;
+    if( ok )
+    {
+        out.resize( static_cast<size_t>( size ) );
+        ok = std::fread( out.data(), 1, out.size(), f ) == out.size();
+    }
+
+    std::fclose( f );
+    return ok;
+}
+
+PipelineCache::~PipelineCache()
+{
+    destroy();
+}
+
+void PipelineCache::fillHeader( FileHeader& header ) const
+{
+    std::memset( &header, 0, sizeof( header ) );
+
+    header.magic         = kCacheMagic;
+    header.fileVersion   = kCacheFileVersion;
+    header.vendorID      = properties_.vendorID;
+    header.deviceID      = properties_.deviceID;
+    header.driverVersion = properties_.driverVersion;
+    std::memcpy( header.pipelineCacheUUID, properties_.pipelineCacheUUID, VK_UUID_SIZE );
+
+    // Zero on 1.0 devices, where the other fields must suffice.
+    std::memcpy( header.deviceUUID, ids_.deviceUUID, VK_UUID_SIZE );
+    std::memcpy( header.driverUUID, ids_.driverUUID, VK_UUID_SIZE );
+}
+
+void PipelineCache::create( const DeviceCaps& caps, VkDevice device, std::string path )
+{
+    properties_  = caps.properties;
+    ids_         = caps.ids;
+    device_      = device;
+    path_        = std::move( path );
+    loadedBytes_ = 0;
+    savedBytes_  = 0;
+    savedHash_   = 0;
+
+    std::vector<uint8_t> file;
+    const uint8_t* initialData = nullptr;
+    size_t initialSize         = 0;
+
+    if( !path_.empty() && readFile( path_, file ) )
+    {
+        FileHeader expected;
+        fillHeader( expected );
+
+        FileHeader stored;
+        bool valid = file.size() >= sizeof( FileHeader );
+        if( valid )
+        {
+            std::memcpy( &stored, file.data(), sizeof( FileHeader ) );
+            const uint8_t* blob = file.data() + sizeof( FileHeader );
+
+            // Everything except the payload description must match the current device and driver exactly.
+            valid = std::memcmp( &stored, &expected, offsetof( FileHeader, dataSize ) ) == 0 &&
+                    stored.dataSize == file.size() - sizeof( FileHeader ) && stored.dataHash == hashBytes( blob, stored.dataSize );
+
+            // The driver's own header (VkPipelineCacheHeaderVersionOne) has to agree as well; a blob too short to
+            // hold one is not valid cache data.
+            valid = valid && stored.dataSize >= 16 + VK_UUID_SIZE;
+            if( valid )
+            {
+                uint32_t vkHeader[4];
+                std::memcpy( vkHeader, blob, sizeof( vkHeader ) );
+                valid = vkHeader[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE && vkHeader[2] == expected.vendorID &&
+                        vkHeader[3] == expected.deviceID && std::memcmp( blob + 16, expected.pipelineCacheUUID, VK_UUID_SIZE ) == 0;
+            }
+        }
+
+        if( valid )
+        {
+            initialData  = file.data() + sizeof( FileHeader );
+            initialSize  = static_cast<size_t>( stored.dataSize );
+            loadedBytes_ = initialSize;
+            savedBytes_  = initialSize;
+            savedHash_   = stored.dataHash;
+        }
+        else
+        {
+            std::fprintf( stderr, "Pipeline cache '%s' is stale or corrupt; starting empty.\n", path_.c_str() );
+        }
+    }
+
+    VkPipelineCacheCreateInfo pcci{};
+    pcci.sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    pcci.initialDataSize = initialSize;
+    pcci.pInitialData    = initialData;
+
+    VkResult r = vkCreatePipelineCache( device_, &pcci, nullptr, &cache_ );
+    if( r != VK_SUCCESS && initialSize > 0 )
+    {
+        // Some drivers reject data they consider incompatible instead of ignoring it.
+        pcci.initialDataSize = 0;
+        pcci.pInitialData    = nullptr;
+        loadedBytes_         = 0;
+        savedBytes_          = 0;
+        savedHash_           = 0;
+        r                    = vkCreatePipelineCache( device_, &pcci, nullptr, &cache_ );
+    }
+    VK_CHECK( r );
+}
+
+bool PipelineCache::save()
+{
+    if( cache_ == VK_NULL_HANDLE || path_.empty() )
+        return true;
+
+    // Pipelines created on another thread meanwhile can grow the cache past the queried size, in which case the copy
+    // reports VK_INCOMPLETE; query again until it fits.
+    std::vector<uint8_t> blob;
+    size_t size = 0;
+    VkResult r  = VK_INCOMPLETE;
+    for( int attempt = 0; attempt < 4 && r == VK_INCOMPLETE; ++attempt )
+    {
+        VK_CHECK( vkGetPipelineCacheData( device_, cache_, &size, nullptr ) );
+        if( size == 0 )
+            return true;
+
+        blob.resize( size );
+        r = vkGetPipelineCacheData( device_, cache_, &size, blob.data() );
+    }
+    if( r == VK_INCOMPLETE )
+    {
+        std::fprintf( stderr, "Pipeline cache kept growing while being saved; not saved this time.\n" );
+        return false;
+    }
+    VK_CHECK( r );
+    blob.resize( size );
+
+    // Drivers may replace entries without changing the blob size, so only identical contents count as unchanged.
+    const uint64_t hash = hashBytes( blob.data(), size );
+    if( size == savedBytes_ && hash == savedHash_ )
+        return true;
+
+    FileHeader header;
+    fillHeader( header );
+    header.dataSize = size;
+    header.dataHash = hash;
+
+    const std::string tmpPath = path_ + ".tmp";
+    std::FILE* f              = std::fopen( tmpPath.c_str(), "wb" );
+    if( !f )
+    {
+        std::fprintf( stderr, "Failed to open '%s' for writing.\n", tmpPath.c_str() );
+        return false;
+    }
+
+    bool ok = std::fwrite( &header, sizeof( header ), 1, f ) == 1 && std::fwrite( blob.data(), 1, size, f ) == size;
+    ok      = std::fflush( f ) == 0 && ok;
+#if defined( __unix__ ) || defined( __APPLE__ )
+    ok = ::fsync( ::fileno( f ) ) == 0 && ok;
+#endif
+    ok = std::fclose( f ) == 0 && ok;
+
+    // rename() replaces the destination atomically, so readers see either the old or the new cache.
+    if( !ok || std::rename( tmpPath.c_str(), path_.c_str() ) != 0 )
+    {
+        std::fprintf( stderr, "Failed to write pipeline cache '%s'.\n", path_.c_str() );
+        std::remove( tmpPath.c_str() );
+        return false;
+    }
+
+    savedBytes_ = size;
+    savedHash_  = hash;
+    return true;
+}
+
+void PipelineCache::destroy()
+{
+    if( cache_ != VK_NULL_HANDLE )
+    {
+        vkDestroyPipelineCache( device_, cache_, nullptr );
+        cache_ = VK_NULL_HANDLE;
+    }
+    device_ = VK_NULL_HANDLE;
+}
@@ -0,0 +1,89 @@
+#include "vk_check.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <vk_renderer/shader_cache.hpp>
+
+// FNV-1a over whole words; SPIR-V is always a multiple of 4 bytes.
+static uint64_t hashWords( const uint32_t* words, size_t count )
+{
+    uint64_t h = 0xCBF29CE484222325ull;
+    for( size_t i = 0; i < count; ++i )
+    {
+        h ^= words[i];
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+ShaderModuleCache::~ShaderModuleCache()
+{
+    destroy();
+}
+
+void ShaderModuleCache::create( VkDevice device )
+{
+    device_ = device;
+}
+
+void ShaderModuleCache::destroy()
+{
+    if( device_ == VK_NULL_HANDLE )
+        return;
+
+    std::lock_guard<std::mutex> lock( mutex_ );
+
+    for( auto& [hash, entries] : modules_ )
+    {
+        for( auto& entry : entries )
+        {
+            vkDestroyShaderModule( device_, entry.module, nullptr );
+        }
+    }
+    modules_.clear();
+    count_ = 0;
+
+    device_ = VK_NULL_HANDLE;
+}
+
+VkShaderModule ShaderModuleCache::get( const uint32_t* code, size_t sizeBytes )
+{
+    if( device_ == VK_NULL_HANDLE || code == nullptr || sizeBytes == 0 || sizeBytes % 4 != 0 )
+        return VK_NULL_HANDLE;
+
+    const size_t wordCount = sizeBytes / 4;
+    const uint64_t hash    = hashWords( code, wordCount );
+
+    std::lock_guard<std::mutex> lock( mutex_ );
+
+    auto& entries = modules_[hash];
+    for( const auto& entry : entries )
+    {
+        if( entry.code.size() == wordCount && std::equal( entry.code.begin(), entry.code.end(), code ) )
+            return entry.module;
+    }
+
+    VkShaderModuleCreateInfo ci{};
+    ci.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    ci.codeSize = sizeBytes;
+    ci.pCode    = code;
+
+    VkShaderModule module = VK_NULL_HANDLE;
+    if( vkCreateShaderModule( device_, &ci, nullptr, &module ) != VK_SUCCESS )
+    {
+        std::fprintf( stderr, "ShaderModuleCache: vkCreateShaderModule failed (%zu bytes)\n", sizeBytes );
+        if( entries.empty() )
+            modules_.erase( hash );
+        return VK_NULL_HANDLE;
+    }
+
+    entries.push_back( { std::vector<uint32_t>( code, code + wordCount ), module } );
+    ++count_;
+    return module;
+}
+
+uint32_t ShaderModuleCache::size() const
+{
+    std::lock_guard<std::mutex> lock( mutex_ );
+    return count_;
+}
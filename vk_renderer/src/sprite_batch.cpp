@@ -0,0 +1,587 @@
+#include "vk_check.hpp"
+
+#if defined( VK_RENDERER_HAS_SHADERS )
+#include "vk_renderer_shaders.hpp"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <vk_renderer/sprite_batch.hpp>
+#include <vk_renderer/vk_renderer.hpp>
+#include <vk_renderer/worker_pool.hpp>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#define VK_RENDERER_SPRITES_X86 1
+#include <immintrin.h>
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#define VK_RENDERER_SPRITES_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Vertex buffer offsets of the three arrays in a slot only need 4-byte alignment; a slot starts on a generous
+// boundary anyway so that slots never share a cache line or a non-coherent atom.
+static constexpr VkDeviceSize kSlotAlignment = 256;
+
+// Sprites per parallel update task; a multiple of every SIMD width, so only the last chunk has a scalar tail.
+static constexpr uint32_t kUpdateChunk = 16384;
+
+struct SpritePushConstants
+{
+    float invExtent[2];
+    float halfSize[2];
+};
+
+// One axis of the bounce: p += v * dt, then positions that left [lo, hi] are mirrored back inside (and clamped, in
+// case a single step crossed the whole range) and their velocity turned to point inwards. Every kernel does exactly
+// these operations, with a separately rounded multiply and add (this file is built with -ffp-contract=off, so the
+// compiler does not fuse them either), so all of them produce the same results; kernelsMatchScalar() checks that.
+using BounceKernel = void ( * )( float* p, float* v, size_t count, float dt, float lo, float hi );
+
+static void bounceScalar( float* p, float* v, size_t count, float dt, float lo, float hi )
+{
+    for( size_t i = 0; i < count; ++i )
+    {
+        const float step = v[i] * dt;
+        float pos        = p[i] + step;
+        float vel        = v[i];
+        if( pos < lo )
+        {
+            pos = lo + lo - pos;
+            vel = std::fabs( vel );
+        }
+        else if( pos > hi )
+        {
+            pos = hi + hi - pos;
+            vel = -std::fabs( vel );
+        }
+        p[i] = std::min( std::max( pos, lo ), hi );
+        v[i] = vel;
+    }
+}
+
+#if defined( VK_RENDERER_SPRITES_X86 )
+
+static void bounceSse2( float* p, float* v, size_t count, float dt, float lo, float hi )
+{
+    const __m128 vdt  = _mm_set1_ps( dt );
+    const __m128 vlo  = _mm_set1_ps( lo );
+    const __m128 vhi  = _mm_set1_ps( hi );
+    const __m128 lo2  = _mm_set1_ps( lo + lo );
+    const __m128 hi2  = _mm_set1_ps( hi + hi );
+    const __m128 sign = _mm_set1_ps( -0.0f );
+
+    size_t i = 0;
+    for( ; i + 4 <= count; i += 4 )
+    {
+        __m128 pos = _mm_loadu_ps( p + i );
+        __m128 vel = _mm_loadu_ps( v + i );
+        pos        = _mm_add_ps( pos, _mm_mul_ps( vel, vdt ) );
+
+        const __m128 below = _mm_cmplt_ps( pos, vlo );
+        const __m128 above = _mm_cmpgt_ps( pos, vhi );
+        const __m128 speed = _mm_andnot_ps( sign, vel );
+
+        // select( mask, a, b ) = ( mask & a ) | ( ~mask & b )
+        pos = _mm_or_ps( _mm_and_ps( below, _mm_sub_ps( lo2, pos ) ), _mm_andnot_ps( below, pos ) );
+        pos = _mm_or_ps( _mm_and_ps( above, _mm_sub_ps( hi2, pos ) ), _mm_andnot_ps( above, pos ) );
+        vel = _mm_or_ps( _mm_and_ps( below, speed ), _mm_andnot_ps( below, vel ) );
+        vel = _mm_or_ps( _mm_and_ps( above, _mm_or_ps( speed, sign ) ), _mm_andnot_ps( above, vel ) );
+
+        _mm_storeu_ps( p + i, _mm_min_ps( _mm_max_ps( pos, vlo ), vhi ) );
+        _mm_storeu_ps( v + i, vel );
+    }
+    bounceScalar( p + i, v + i, count - i, dt, lo, hi );
+}
+
+// Built for AVX regardless of the compiler flags and only called when the CPU has it.
+__attribute__( ( target( "avx" ) ) ) static void bounceAvx( float* p, float* v, size_t count, float dt, float lo, float hi )
+{
+    const __m256 vdt  = _mm256_set1_ps( dt );
+    const __m256 vlo  = _mm256_set1_ps( lo );
+    const __m256 vhi  = _mm256_set1_ps( hi );
+    const __m256 lo2  = _mm256_set1_ps( lo + lo );
+    const __m256 hi2  = _mm256_set1_ps( hi + hi );
+    const __m256 sign = _mm256_set1_ps( -0.0f );
+
+    size_t i = 0;
+    for( ; i + 8 <= count; i += 8 )
+    {
+        __m256 pos = _mm256_loadu_ps( p + i );
+        __m256 vel = _mm256_loadu_ps( v + i );
+        pos        = _mm256_add_ps( pos, _mm256_mul_ps( vel, vdt ) );
+
+        const __m256 below = _mm256_cmp_ps( pos, vlo, _CMP_LT_OQ );
+        const __m256 above = _mm256_cmp_ps( pos, vhi, _CMP_GT_OQ );
+        const __m256 speed = _mm256_andnot_ps( sign, vel );
+
+        pos = _mm256_blendv_ps( pos, _mm256_sub_ps( lo2, pos ), below );
+        pos = _mm256_blendv_ps( pos, _mm256_sub_ps( hi2, pos ), above );
+        vel = _mm256_blendv_ps( vel, speed, below );
+        vel = _mm256_blendv_ps( vel, _mm256_or_ps( speed, sign ), above );
+
+        _mm256_storeu_ps( p + i, _mm256_min_ps( _mm256_max_ps( pos, vlo ), vhi ) );
+        _mm256_storeu_ps( v + i, vel );
+    }
+    bounceSse2( p + i, v + i, count - i, dt, lo, hi );
+}
+
+#elif defined( VK_RENDERER_SPRITES_NEON )
+
+static void bounceNeon( float* p, float* v, size_t count, float dt, float lo, float hi )
+{
+    const float32x4_t vdt = vdupq_n_f32( dt );
+    const float32x4_t vlo = vdupq_n_f32( lo );
+    const float32x4_t vhi = vdupq_n_f32( hi );
+    const float32x4_t lo2 = vdupq_n_f32( lo + lo );
+    const float32x4_t hi2 = vdupq_n_f32( hi + hi );
+
+    size_t i = 0;
+    for( ; i + 4 <= count; i += 4 )
+    {
+        float32x4_t pos = vld1q_f32( p + i );
+        float32x4_t vel = vld1q_f32( v + i );
+        pos             = vaddq_f32( pos, vmulq_f32( vel, vdt ) );
+
+        const uint32x4_t below  = vcltq_f32( pos, vlo );
+        const uint32x4_t above  = vcgtq_f32( pos, vhi );
+        const float32x4_t speed = vabsq_f32( vel );
+
+        pos = vbslq_f32( below, vsubq_f32( lo2, pos ), pos );
+        pos = vbslq_f32( above, vsubq_f32( hi2, pos ), pos );
+        vel = vbslq_f32( below, speed, vel );
+        vel = vbslq_f32( above, vnegq_f32( speed ), vel );
+
+        vst1q_f32( p + i, vminq_f32( vmaxq_f32( pos, vlo ), vhi ) );
+        vst1q_f32( v + i, vel );
+    }
+    bounceScalar( p + i, v + i, count - i, dt, lo, hi );
+}
+
+#endif
+
+struct KernelChoice
+{
+    BounceKernel bounce;
+    const char* name;
+};
+
+static KernelChoice selectKernel()
+{
+#if defined( VK_RENDERER_SPRITES_X86 )
+    if( __builtin_cpu_supports( "avx" ) )
+        return { bounceAvx, "avx" };
+    return { bounceSse2, "sse2" };
+#elif defined( VK_RENDERER_SPRITES_NEON )
+    return { bounceNeon, "neon" };
+#else
+    return { bounceScalar, "scalar" };
+#endif
+}
+
+// Picked once, on first use.
+static const KernelChoice& kernel()
+{
+    static const KernelChoice choice = selectKernel();
+    return choice;
+}
+
+SpriteBatch::~SpriteBatch()
+{
+    destroy();
+}
+
+const char* SpriteBatch::simdPath()
+{
+    return kernel().name;
+}
+
+bool SpriteBatch::kernelsMatchScalar()
+{
+    std::vector<BounceKernel> kernels;
+#if defined( VK_RENDERER_SPRITES_X86 )
+    kernels.push_back( bounceSse2 );
+    if( __builtin_cpu_supports( "avx" ) )
+        kernels.push_back( bounceAvx );
+#elif defined( VK_RENDERER_SPRITES_NEON )
+    kernels.push_back( bounceNeon );
+#endif
+
+    // Not a multiple of any SIMD width, so the scalar tails run too. Positions start inside and outside the bounds,
+    // and the fastest sprites cross the whole range in one step.
+    constexpr size_t kCount = 1027;
+    constexpr float kLo     = 3.5f;
+    constexpr float kHi     = 797.25f;
+    constexpr float kDt     = 0.37f;
+
+    uint32_t seed = 1;
+    auto random   = [&seed]( float lo, float hi ) {
+        seed = seed * 1664525u + 1013904223u;
+        return lo + ( hi - lo ) * static_cast<float>( seed >> 8 ) * ( 1.0f / 16777216.0f );
+    };
+    std::vector<float> p( kCount );
+    std::vector<float> v( kCount );
+    for( size_t i = 0; i < kCount; ++i )
+    {
+        p[i] = random( kLo - 100.0f, kHi + 100.0f );
+        v[i] = random( -3000.0f, 3000.0f );
+    }
+
+    for( BounceKernel bounce : kernels )
+    {
+        std::vector<float> expectedP = p, expectedV = v, actualP = p, actualV = v;
+        for( int step = 0; step < 4; ++step )
+        {
+            bounceScalar( expectedP.data(), expectedV.data(), kCount, kDt, kLo, kHi );
+            bounce( actualP.data(), actualV.data(), kCount, kDt, kLo, kHi );
+        }
+        if( std::memcmp( expectedP.data(), actualP.data(), kCount * sizeof( float ) ) != 0 ||
+            std::memcmp( expectedV.data(), actualV.data(), kCount * sizeof( float ) ) != 0 )
+            return false;
+    }
+    return true;
+}
+
+bool SpriteBatch::create( VulkanRenderer& renderer, uint32_t capacity )
+{
+    if( capacity == 0 )
+        return false;
+
+    renderer_ = &renderer;
+    device_   = renderer.device();
+    capacity_ = capacity;
+    count_    = 0;
+
+    x_.assign( capacity, 0.0f );
+    y_.assign( capacity, 0.0f );
+    vx_.assign( capacity, 0.0f );
+    vy_.assign( capacity, 0.0f );
+    color_.assign( capacity, 0 );
+
+    colorVersion_ = 0;
+    slotColorVersion_.assign( renderer.framesInFlight(), 0 );
+
+    const VkExtent2D extent = renderer.extent();
+    setBounds( static_cast<float>( extent.width ), static_cast<float>( extent.height ) );
+
+    slotStride_ = ( VkDeviceSize( capacity ) * 12 + kSlotAlignment - 1 ) / kSlotAlignment * kSlotAlignment;
+
+    VkBufferCreateInfo bci{};
+    bci.sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bci.size        = slotStride_ * renderer.framesInFlight();
+    bci.usage       = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    bci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    instanceBuffer_ = renderer.allocator().createBuffer( bci, GpuMemoryUsage::CpuToGpu, &instanceMemory_ );
+    if( instanceBuffer_ == VK_NULL_HANDLE || !instanceMemory_->mapped )
+    {
+        std::fprintf( stderr, "SpriteBatch: failed to allocate the instance buffer for %u sprites.\n", capacity );
+        destroy();
+        return false;
+    }
+
+    // The pipeline is built by the first record(), once the target exists. Not having the shaders is not an error:
+    // the batch still simulates and streams, it just cannot draw.
+    return true;
+}
+
+void SpriteBatch::destroy()
+{
+    if( renderer_ == nullptr )
+        return;
+
+    // After the renderer's shutdown() the device and everything created from it are gone already.
+    if( renderer_->device() != VK_NULL_HANDLE )
+    {
+        destroyPipeline();
+        if( pipelineLayout_ != VK_NULL_HANDLE )
+        {
+            renderer_->deferDestroy( pipelineLayout_, vkDestroyPipelineLayout );
+        }
+        if( instanceBuffer_ != VK_NULL_HANDLE )
+        {
+            renderer_->deferDestroyBuffer( instanceBuffer_, instanceMemory_ );
+        }
+    }
+    instanceBuffer_ = VK_NULL_HANDLE;
+    instanceMemory_ = nullptr;
+    pipeline_       = VK_NULL_HANDLE;
+    pipelineLayout_ = VK_NULL_HANDLE;
+    pipelineBuilt_  = false;
+
+    x_.clear();
+    y_.clear();
+    vx_.clear();
+    vy_.clear();
+    color_.clear();
+    slotColorVersion_.clear();
+    count_    = 0;
+    capacity_ = 0;
+
+    renderer_ = nullptr;
+    device_   = VK_NULL_HANDLE;
+}
+
+uint32_t SpriteBatch::add( float x, float y, float vx, float vy, uint32_t color )
+{
+    if( count_ == capacity_ )
+        return kInvalid;
+
+    const uint32_t i = count_++;
+    x_[i]            = x;
+    y_[i]            = y;
+    vx_[i]           = vx;
+    vy_[i]           = vy;
+    color_[i]        = color;
+    ++colorVersion_;
+    return i;
+}
+
+void SpriteBatch::clear()
+{
+    count_ = 0;
+    ++colorVersion_;
+}
+
+void SpriteBatch::setSpriteSize( float width, float height )
+{
+    halfWidth_  = width * 0.5f;
+    halfHeight_ = height * 0.5f;
+}
+
+void SpriteBatch::setBounds( float width, float height )
+{
+    boundsWidth_  = width;
+    boundsHeight_ = height;
+}
+
+void SpriteBatch::update( float dt, WorkerPool* pool )
+{
+    // Centres stay half a sprite away from the edges; a bounds smaller than a sprite pins it to the middle.
+    const float minX = halfWidth_;
+    const float minY = halfHeight_;
+    const float maxX = std::max( boundsWidth_ - halfWidth_, minX );
+    const float maxY = std::max( boundsHeight_ - halfHeight_, minY );
+
+    const BounceKernel bounce = kernel().bounce;
+    if( pool == nullptr || count_ <= kUpdateChunk )
+    {
+        bounce( x_.data(), vx_.data(), count_, dt, minX, maxX );
+        bounce( y_.data(), vy_.data(), count_, dt, minY, maxY );
+        return;
+    }
+
+    const uint32_t chunks = ( count_ + kUpdateChunk - 1 ) / kUpdateChunk;
+    pool->parallelFor( chunks, [&]( uint32_t chunk, uint32_t ) {
+        const uint32_t begin = chunk * kUpdateChunk;
+        const uint32_t n     = std::min( kUpdateChunk, count_ - begin );
+        bounce( x_.data() + begin, vx_.data() + begin, n, dt, minX, maxX );
+        bounce( y_.data() + begin, vy_.data() + begin, n, dt, minY, maxY );
+    } );
+}
+
+void SpriteBatch::record( VkCommandBuffer cmd )
+{
+    if( renderer_ == nullptr || count_ == 0 )
+        return;
+
+    // The frame that last used this slot has finished (drawFrame() waited for it before recording), so its region
+    // can be overwritten. The memory is host-coherent; nothing needs flushing.
+    const uint32_t slot       = renderer_->currentFrameIndex();
+    const VkDeviceSize offset = slotStride_ * slot;
+    auto* base                = static_cast<uint8_t*>( instanceMemory_->mapped ) + offset;
+
+    std::memcpy( base, x_.data(), count_ * sizeof( float ) );
+    std::memcpy( base + capacity_ * sizeof( float ), y_.data(), count_ * sizeof( float ) );
+    if( slotColorVersion_[slot] != colorVersion_ )
+    {
+        std::memcpy( base + capacity_ * 2 * sizeof( float ), color_.data(), count_ * sizeof( uint32_t ) );
+        slotColorVersion_[slot] = colorVersion_;
+    }
+
+    // Built here rather than in create(): in external mode the host's first frame is what provides the target. The
+    // target format can change with the swapchain (e.g. moving to another display); a failed build is not retried
+    // until it does.
+    const VkFormat format = renderer_->colorFormat();
+    if( !pipelineBuilt_ || pipelineFormat_ != format )
+    {
+        destroyPipeline();
+        pipelineBuilt_  = true;
+        pipelineFormat_ = format;
+        createPipeline();
+    }
+    if( pipeline_ == VK_NULL_HANDLE )
+        return;
+
+    const VkExtent2D extent = renderer_->extent();
+
+    VkViewport viewport{};
+    viewport.width    = static_cast<float>( extent.width );
+    viewport.height   = static_cast<float>( extent.height );
+    viewport.maxDepth = 1.0f;
+    VkRect2D scissor{ { 0, 0 }, extent };
+
+    SpritePushConstants push{};
+    push.invExtent[0] = 1.0f / std::max( viewport.width, 1.0f );
+    push.invExtent[1] = 1.0f / std::max( viewport.height, 1.0f );
+    push.halfSize[0]  = halfWidth_;
+    push.halfSize[1]  = halfHeight_;
+
+    const VkBuffer buffers[3]     = { instanceBuffer_, instanceBuffer_, instanceBuffer_ };
+    const VkDeviceSize offsets[3] = { offset, offset + capacity_ * sizeof( float ), offset + capacity_ * 2 * sizeof( float ) };
+
+    const DeviceDispatch& vk = renderer_->dispatch();
+    vk.vkCmdBindPipeline( cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_ );
+    vk.vkCmdSetViewport( cmd, 0, 1, &viewport );
+    vk.vkCmdSetScissor( cmd, 0, 1, &scissor );
+    vk.vkCmdPushConstants( cmd, pipelineLayout_, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof( push ), &push );
+    vk.vkCmdBindVertexBuffers( cmd, 0, 3, buffers, offsets );
+    vk.vkCmdDraw( cmd, 4, count_, 0, 0 );
+}
+
+bool SpriteBatch::createPipeline()
+{
+#if defined( VK_RENDERER_HAS_SHADERS )
+    VkShaderModule vert = renderer_->shaders().get( vk_renderer_shaders::sprite_vert );
+    VkShaderModule frag = renderer_->shaders().get( vk_renderer_shaders::sprite_frag );
+    if( vert == VK_NULL_HANDLE || frag == VK_NULL_HANDLE )
+        return false;
+
+    if( pipelineLayout_ == VK_NULL_HANDLE )
+    {
+        VkPushConstantRange range{};
+        range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        range.size       = sizeof( SpritePushConstants );
+
+        VkPipelineLayoutCreateInfo plci{};
+        plci.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        plci.pushConstantRangeCount = 1;
+        plci.pPushConstantRanges    = &range;
+        VK_CHECK( vkCreatePipelineLayout( device_, &plci, nullptr, &pipelineLayout_ ) );
+    }
+
+    VkPipelineShaderStageCreateInfo stages[2]{};
+    stages[0].sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage  = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vert;
+    stages[0].pName  = "main";
+    stages[1].sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage  = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = frag;
+    stages[1].pName  = "main";
+
+    // x, y and color each come from their own tightly packed per-instance array.
+    VkVertexInputBindingDescription bindings[3]{};
+    VkVertexInputAttributeDescription attributes[3]{};
+    const VkFormat formats[3] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32_SFLOAT, VK_FORMAT_R8G8B8A8_UNORM };
+    for( uint32_t i = 0; i < 3; ++i )
+    {
+        bindings[i].binding     = i;
+        bindings[i].stride      = 4;
+        bindings[i].inputRate   = VK_VERTEX_INPUT_RATE_INSTANCE;
+        attributes[i].location  = i;
+        attributes[i].binding   = i;
+        attributes[i].format    = formats[i];
+    }
+
+    VkPipelineVertexInputStateCreateInfo vertexInput{};
+    vertexInput.sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInput.vertexBindingDescriptionCount   = 3;
+    vertexInput.pVertexBindingDescriptions      = bindings;
+    vertexInput.vertexAttributeDescriptionCount = 3;
+    vertexInput.pVertexAttributeDescriptions    = attributes;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType    = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount  = 1;
+
+    VkPipelineRasterizationStateCreateInfo raster{};
+    raster.sType       = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    raster.polygonMode = VK_POLYGON_MODE_FILL;
+    raster.cullMode    = VK_CULL_MODE_NONE;
+    raster.frontFace   = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    raster.lineWidth   = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample{};
+    multisample.sType                = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    // Tests off; only given so the pipeline also fits render passes with a depth-stencil attachment (Qt Quick's).
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+
+    VkPipelineColorBlendAttachmentState blendAttachment{};
+    blendAttachment.blendEnable         = VK_TRUE;
+    blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachment.colorBlendOp        = VK_BLEND_OP_ADD;
+    blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachment.alphaBlendOp        = VK_BLEND_OP_ADD;
+    blendAttachment.colorWriteMask      = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
+                                          VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo blend{};
+    blend.sType           = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    blend.attachmentCount = 1;
+    blend.pAttachments    = &blendAttachment;
+
+    const VkDynamicState dynamicStates[2] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+    VkPipelineDynamicStateCreateInfo dynamic{};
+    dynamic.sType             = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic.dynamicStateCount = 2;
+    dynamic.pDynamicStates    = dynamicStates;
+
+    const VkFormat colorFormat = renderer_->colorFormat();
+
+    VkPipelineRenderingCreateInfoKHR rendering{};
+    rendering.sType                   = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    rendering.colorAttachmentCount    = 1;
+    rendering.pColorAttachmentFormats = &colorFormat;
+
+    VkGraphicsPipelineCreateInfo gpci{};
+    gpci.sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    gpci.pNext               = renderer_->dynamicRendering() ? &rendering : nullptr;
+    gpci.stageCount          = 2;
+    gpci.pStages             = stages;
+    gpci.pVertexInputState   = &vertexInput;
+    gpci.pInputAssemblyState = &inputAssembly;
+    gpci.pViewportState      = &viewportState;
+    gpci.pRasterizationState = &raster;
+    gpci.pMultisampleState   = &multisample;
+    gpci.pDepthStencilState  = &depthStencil;
+    gpci.pColorBlendState    = &blend;
+    gpci.pDynamicState       = &dynamic;
+    gpci.layout              = pipelineLayout_;
+    gpci.renderPass          = renderer_->renderPass();
+
+    if( vkCreateGraphicsPipelines( device_, renderer_->pipelineCache(), 1, &gpci, nullptr, &pipeline_ ) != VK_SUCCESS )
+    {
+        std::fprintf( stderr, "SpriteBatch: failed to create the sprite pipeline.\n" );
+        pipeline_ = VK_NULL_HANDLE;
+        return false;
+    }
+    return true;
+#else
+    std::fprintf( stderr, "SpriteBatch: built without shaders (no GLSL compiler at configure time); sprites are not drawn.\n" );
+    return false;
+#endif
+}
+
+void SpriteBatch::destroyPipeline()
+{
+    // Frames in flight may still be drawing with the old pipeline.
+    if( pipeline_ != VK_NULL_HANDLE )
+    {
+        renderer_->deferDestroy( pipeline_, vkDestroyPipeline );
+        pipeline_ = VK_NULL_HANDLE;
+    }
+}
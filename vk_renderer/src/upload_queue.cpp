@@ -0,0 +1,367 @@
+#include "vk_check.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vk_renderer/upload_queue.hpp>
+
+// Satisfies bufferOffset rules for every uncompressed and block-compressed format (multiple of 4 and of the texel
+// block size) and is a common optimalBufferCopyOffsetAlignment.
+static constexpr VkDeviceSize kStagingAlignment = 16;
+
+UploadQueue::~UploadQueue()
+{
+    destroy();
+}
+
+void UploadQueue::create( VkDevice device, const DeviceDispatch& vk, GpuAllocator& allocator, VkQueue transferQueue,
+                          uint32_t transferFamily, uint32_t graphicsFamily, VkDeviceSize ringSize, bool frameSemaphores )
+{
+    device_          = device;
+    vk_              = &vk;
+    allocator_       = &allocator;
+    transferQueue_   = transferQueue;
+    transferFamily_  = transferFamily;
+    graphicsFamily_  = graphicsFamily;
+    frameSemaphores_ = frameSemaphores;
+    ringSize_        = ( ringSize + kStagingAlignment - 1 ) / kStagingAlignment * kStagingAlignment;
+    head_            = 0;
+    tail_            = 0;
+    nextTicket_      = 1;
+    completed_.store( 0, std::memory_order_relaxed );
+
+    VkBufferCreateInfo bci{};
+    bci.sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bci.size        = ringSize_;
+    bci.usage       = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    ring_ = allocator_->createBuffer( bci, GpuMemoryUsage::CpuToGpu, &ringAlloc_ );
+    if( ring_ == VK_NULL_HANDLE || !ringAlloc_->mapped )
+    {
+        std::fprintf( stderr, "Failed to allocate the %llu byte staging ring.\n", (unsigned long long)ringSize_ );
+        std::abort();
+    }
+}
+
+void UploadQueue::destroy()
+{
+    if( device_ == VK_NULL_HANDLE )
+        return;
+
+    // Callers idle the device first.
+    std::lock_guard<std::mutex> lock( mutex_ );
+    if( open_ )
+    {
+        destroyBatch( *open_ );
+        open_.reset();
+    }
+    for( auto* list : { &inFlight_, &retiring_ } )
+    {
+        for( auto& batch : *list )
+        {
+            destroyBatch( *batch );
+        }
+        list->clear();
+    }
+    for( auto& batch : free_ )
+    {
+        destroyBatch( *batch );
+    }
+    free_.clear();
+
+    allocator_->destroyBuffer( ring_, ringAlloc_ );
+    ring_      = VK_NULL_HANDLE;
+    ringAlloc_ = nullptr;
+    device_    = VK_NULL_HANDLE;
+}
+
+void UploadQueue::destroyBatch( Batch& batch )
+{
+    vk_->vkDestroyFence( device_, batch.fence, nullptr );
+    vk_->vkDestroySemaphore( device_, batch.semaphore, nullptr );
+    vk_->vkDestroyCommandPool( device_, batch.pool, nullptr );
+}
+
+bool UploadQueue::reserve( VkDeviceSize size, VkDeviceSize& offset )
+{
+    if( size > ringSize_ )
+    {
+        std::fprintf( stderr, "Upload of %llu bytes exceeds the %llu byte staging ring.\n", (unsigned long long)size,
+                      (unsigned long long)ringSize_ );
+        return false;
+    }
+
+    uint64_t start = ( head_ + kStagingAlignment - 1 ) / kStagingAlignment * kStagingAlignment;
+    if( start % ringSize_ + size > ringSize_ )
+    {
+        start = ( start / ringSize_ + 1 ) * ringSize_; // does not fit before the end; wrap to the beginning
+    }
+    if( start + size - tail_ > ringSize_ )
+        return false; // would overwrite data that in-flight batches still read
+
+    head_  = start + size;
+    offset = start % ringSize_;
+    return true;
+}
+
+UploadQueue::Batch& UploadQueue::openBatch()
+{
+    if( open_ )
+        return *open_;
+
+    if( !free_.empty() )
+    {
+        open_ = std::move( free_.back() );
+        free_.pop_back();
+        VK_CHECK( vk_->vkResetFences( device_, 1, &open_->fence ) );
+        VK_CHECK( vk_->vkResetCommandPool( device_, open_->pool, 0 ) );
+    }
+    else
+    {
+        open_ = std::make_unique<Batch>();
+
+        VkCommandPoolCreateInfo cpci{};
+        cpci.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        cpci.queueFamilyIndex = transferFamily_;
+        cpci.flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        VK_CHECK( vk_->vkCreateCommandPool( device_, &cpci, nullptr, &open_->pool ) );
+
+        VkCommandBufferAllocateInfo cbai{};
+        cbai.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cbai.commandPool        = open_->pool;
+        cbai.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cbai.commandBufferCount = 1;
+        VK_CHECK( vk_->vkAllocateCommandBuffers( device_, &cbai, &open_->cmd ) );
+
+        VkFenceCreateInfo fci{};
+        fci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VK_CHECK( vk_->vkCreateFence( device_, &fci, nullptr, &open_->fence ) );
+
+        if( frameSemaphores_ )
+        {
+            VkSemaphoreCreateInfo sci{};
+            sci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            VK_CHECK( vk_->vkCreateSemaphore( device_, &sci, nullptr, &open_->semaphore ) );
+        }
+    }
+
+    open_->ticket = nextTicket_++;
+    open_->bufferAcquires.clear();
+    open_->imageAcquires.clear();
+
+    VkCommandBufferBeginInfo bi{};
+    bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK( vk_->vkBeginCommandBuffer( open_->cmd, &bi ) );
+
+    return *open_;
+}
+
+UploadTicket UploadQueue::uploadBuffer( VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size )
+{
+    return queued( queueBuffer( dst, dstOffset, data, size ) );
+}
+
+UploadTicket UploadQueue::uploadImage( VkImage dst, VkExtent3D extent, uint32_t mipLevel, uint32_t layerCount, const void* data,
+                                       VkDeviceSize size, VkImageLayout finalLayout, VkImageAspectFlags aspect )
+{
+    return queued( queueImage( dst, extent, mipLevel, layerCount, data, size, finalLayout, aspect ) );
+}
+
+UploadTicket UploadQueue::queued( UploadTicket ticket )
+{
+    if( ticket != 0 && queuedCallback_ )
+    {
+        queuedCallback_();
+    }
+    return ticket;
+}
+
+UploadTicket UploadQueue::queueBuffer( VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size )
+{
+    if( size == 0 )
+        return 0;
+
+    std::lock_guard<std::mutex> lock( mutex_ );
+
+    VkDeviceSize offset = 0;
+    if( !reserve( size, offset ) )
+        return 0;
+
+    std::memcpy( static_cast<char*>( ringAlloc_->mapped ) + offset, data, static_cast<size_t>( size ) );
+
+    Batch& batch = openBatch();
+
+    VkBufferCopy region{};
+    region.srcOffset = offset;
+    region.dstOffset = dstOffset;
+    region.size      = size;
+    vk_->vkCmdCopyBuffer( batch.cmd, ring_, dst, 1, &region );
+
+    if( ownershipTransfer() )
+    {
+        VkBufferMemoryBarrier release{};
+        release.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        release.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+        release.srcQueueFamilyIndex = transferFamily_;
+        release.dstQueueFamilyIndex = graphicsFamily_;
+        release.buffer              = dst;
+        release.offset              = dstOffset;
+        release.size                = size;
+        vk_->vkCmdPipelineBarrier( batch.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1,
+                                   &release, 0, nullptr );
+
+        VkBufferMemoryBarrier acquire = release;
+        acquire.srcAccessMask         = 0;
+        acquire.dstAccessMask         = VK_ACCESS_MEMORY_READ_BIT;
+        batch.bufferAcquires.push_back( acquire );
+    }
+
+    return batch.ticket;
+}
+
+UploadTicket UploadQueue::queueImage( VkImage dst, VkExtent3D extent, uint32_t mipLevel, uint32_t layerCount, const void* data,
+                                      VkDeviceSize size, VkImageLayout finalLayout, VkImageAspectFlags aspect )
+{
+    if( size == 0 )
+        return 0;
+
+    std::lock_guard<std::mutex> lock( mutex_ );
+
+    VkDeviceSize offset = 0;
+    if( !reserve( size, offset ) )
+        return 0;
+
+    std::memcpy( static_cast<char*>( ringAlloc_->mapped ) + offset, data, static_cast<size_t>( size ) );
+
+    Batch& batch = openBatch();
+
+    VkImageMemoryBarrier toTransfer{};
+    toTransfer.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    toTransfer.dstAccessMask                   = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toTransfer.oldLayout                       = VK_IMAGE_LAYOUT_UNDEFINED;
+    toTransfer.newLayout                       = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    toTransfer.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    toTransfer.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    toTransfer.image                           = dst;
+    toTransfer.subresourceRange.aspectMask     = aspect;
+    toTransfer.subresourceRange.baseMipLevel   = mipLevel;
+    toTransfer.subresourceRange.levelCount     = 1;
+    toTransfer.subresourceRange.baseArrayLayer = 0;
+    toTransfer.subresourceRange.layerCount     = layerCount;
+    vk_->vkCmdPipelineBarrier( batch.cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+                               &toTransfer );
+
+    VkBufferImageCopy region{};
+    region.bufferOffset                    = offset;
+    region.imageSubresource.aspectMask     = aspect;
+    region.imageSubresource.mipLevel       = mipLevel;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount     = layerCount;
+    region.imageExtent                     = extent;
+    vk_->vkCmdCopyBufferToImage( batch.cmd, ring_, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region );
+
+    // Same family: a plain transition; the frame's semaphore wait makes the copy visible. Otherwise the transition
+    // is part of the release, and the graphics queue repeats it in the acquire.
+    VkImageMemoryBarrier release = toTransfer;
+    release.srcAccessMask        = VK_ACCESS_TRANSFER_WRITE_BIT;
+    release.dstAccessMask        = 0;
+    release.oldLayout            = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    release.newLayout            = finalLayout;
+    if( ownershipTransfer() )
+    {
+        release.srcQueueFamilyIndex = transferFamily_;
+        release.dstQueueFamilyIndex = graphicsFamily_;
+    }
+    vk_->vkCmdPipelineBarrier( batch.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr,
+                               1, &release );
+
+    if( ownershipTransfer() )
+    {
+        VkImageMemoryBarrier acquire = release;
+        acquire.srcAccessMask        = 0;
+        acquire.dstAccessMask        = VK_ACCESS_MEMORY_READ_BIT;
+        batch.imageAcquires.push_back( acquire );
+    }
+
+    return batch.ticket;
+}
+
+bool UploadQueue::hasPending() const
+{
+    std::lock_guard<std::mutex> lock( mutex_ );
+    return open_ != nullptr || !inFlight_.empty();
+}
+
+void UploadQueue::submit()
+{
+    std::lock_guard<std::mutex> lock( mutex_ );
+    if( !open_ )
+        return;
+
+    VK_CHECK( vk_->vkEndCommandBuffer( open_->cmd ) );
+
+    VkSubmitInfo si{};
+    si.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    si.commandBufferCount   = 1;
+    si.pCommandBuffers      = &open_->cmd;
+    si.signalSemaphoreCount = frameSemaphores_ ? 1 : 0;
+    si.pSignalSemaphores    = frameSemaphores_ ? &open_->semaphore : nullptr;
+    VK_CHECK( vk_->vkQueueSubmit( transferQueue_, 1, &si, open_->fence ) );
+
+    open_->ringEnd = head_;
+    inFlight_.push_back( std::move( open_ ) );
+}
+
+void UploadQueue::acquire( VkCommandBuffer cmd, uint64_t frame, uint64_t completedFrames, std::vector<VkSemaphore>& waitSemaphores )
+{
+    std::lock_guard<std::mutex> lock( mutex_ );
+
+    // A batch's semaphore can be signaled again once the frame that waited on it has finished.
+    while( !retiring_.empty() && retiring_.front()->waitFrame <= completedFrames )
+    {
+        free_.push_back( std::move( retiring_.front() ) );
+        retiring_.pop_front();
+    }
+
+    bufferBarriers_.clear();
+    imageBarriers_.clear();
+    bool handedOver = false;
+
+    // The transfer queue completes batches in submission order, so stop at the first unfinished one.
+    while( !inFlight_.empty() && vk_->vkGetFenceStatus( device_, inFlight_.front()->fence ) == VK_SUCCESS )
+    {
+        std::unique_ptr<Batch> batch = std::move( inFlight_.front() );
+        inFlight_.pop_front();
+
+        tail_ = batch->ringEnd;
+        bufferBarriers_.insert( bufferBarriers_.end(), batch->bufferAcquires.begin(), batch->bufferAcquires.end() );
+        imageBarriers_.insert( imageBarriers_.end(), batch->imageAcquires.begin(), batch->imageAcquires.end() );
+        if( frameSemaphores_ )
+            waitSemaphores.push_back( batch->semaphore );
+        handedOver = true;
+        completed_.store( batch->ticket, std::memory_order_release );
+
+        batch->waitFrame = frame;
+        retiring_.push_back( std::move( batch ) );
+    }
+
+    if( !bufferBarriers_.empty() || !imageBarriers_.empty() )
+    {
+        vk_->vkCmdPipelineBarrier( cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+                                   static_cast<uint32_t>( bufferBarriers_.size() ), bufferBarriers_.data(),
+                                   static_cast<uint32_t>( imageBarriers_.size() ), imageBarriers_.data() );
+    }
+
+    // Same queue, earlier submit: a barrier is enough to make the copies visible to the frame.
+    if( handedOver && !frameSemaphores_ )
+    {
+        VkMemoryBarrier barrier{};
+        barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT; // the copies and the layout transitions after them
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        vk_->vkCmdPipelineBarrier( cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr,
+                                   0, nullptr );
+    }
+}
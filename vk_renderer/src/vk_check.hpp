@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <vk_renderer/vulkan_functions.hpp>
+
+#define VK_CHECK( expr )                                                                                                                   \
+    do                                                                                                                                     \
+    {                                                                                                                                      \
+        VkResult _vk_result = ( expr );                                                                                                    \
+        if( _vk_result != VK_SUCCESS )                                                                                                     \
+        {                                                                                                                                  \
+            std::fprintf( stderr, "Vulkan error %d at %s:%d\n", (int)_vk_result, __FILE__, __LINE__ );                                     \
+            std::abort();                                                                                                                  \
+        }                                                                                                                                  \
+    } while( 0 )
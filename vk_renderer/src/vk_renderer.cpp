@@ -1,57 +1,64 @@
+#include "vk_check.hpp"
+
 #include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <utility>
 #include <vector>
 #include <vk_renderer/vk_renderer.hpp>
 #include <vulkan/vulkan.h>
+
+#if defined( VK_ENABLE_BETA_EXTENSIONS )
 #include <vulkan/vulkan_beta.h>
+#endif
+
+#if defined( VK_USE_PLATFORM_METAL_EXT )
 #include <vulkan/vulkan_metal.h>
+#endif
 
 #if defined( VK_RENDERER_USE_GLFW )
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 #endif
 
-#define VK_CHECK( expr )                                                                                                                   \
-    do                                                                                                                                     \
-    {                                                                                                                                      \
-        VkResult _vk_result = ( expr );                                                                                                    \
-        if( _vk_result != VK_SUCCESS )                                                                                                     \
-        {                                                                                                                                  \
-            std::fprintf( stderr, "Vulkan error %d at %s:%d\n", (int)_vk_result, __FILE__, __LINE__ );                                     \
-            std::abort();                                                                                                                  \
-        }                                                                                                                                  \
-    } while( 0 )
-
-static bool hasInstanceExtension( const char* name )
+// Preferred present modes per policy, best first. FIFO is the only mode the spec guarantees, so every list ends with it.
+static std::vector<VkPresentModeKHR> presentModePreference( VulkanRenderer::PresentPolicy policy )
 {
-    uint32_t count = 0;
-    vkEnumerateInstanceExtensionProperties( nullptr, &count, nullptr );
-    std::vector<VkExtensionProperties> exts( count );
-    vkEnumerateInstanceExtensionProperties( nullptr, &count, exts.data() );
-
-    for( const auto& e : exts )
+    switch( policy )
     {
-        if( std::strcmp( e.extensionName, name ) == 0 )
-            return true;
+        case VulkanRenderer::PresentPolicy::LowLatency:
+            return { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR };
+        case VulkanRenderer::PresentPolicy::Uncapped:
+            return { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR };
+        case VulkanRenderer::PresentPolicy::AdaptiveVsync:
+            return { VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR };
+        case VulkanRenderer::PresentPolicy::PowerSaving:
+        default:
+            return { VK_PRESENT_MODE_FIFO_KHR };
     }
-    return false;
 }
 
-static bool hasDeviceExtension( VkPhysicalDevice pd, const char* name )
+using FrameClock = std::chrono::steady_clock;
+
+static double elapsedMs( FrameClock::time_point from, FrameClock::time_point to )
 {
-    uint32_t count = 0;
-    vkEnumerateDeviceExtensionProperties( pd, nullptr, &count, nullptr );
-    std::vector<VkExtensionProperties> exts( count );
-    vkEnumerateDeviceExtensionProperties( pd, nullptr, &count, exts.data() );
+    return std::chrono::duration<double, std::milli>( to - from ).count();
+}
 
-    for( const auto& e : exts )
-    {
-        if( std::strcmp( e.extensionName, name ) == 0 )
-            return true;
-    }
-    return false;
+// The renderer whose render thread this is, if any; lets calls from the render thread itself run directly.
+static thread_local const VulkanRenderer* tlsRenderThreadOwner = nullptr;
+
+VulkanRenderer::VulkanRenderer()
+{
+    // Uploads count as frame requests and may come from any thread, so a sleeping render thread has to notice them.
+    uploads_.setQueuedCallback( [this]
+                                {
+                                    if( renderThreadActive_ )
+                                        wakeRenderThread();
+                                } );
 }
 
 VulkanRenderer::~VulkanRenderer()
@@ -61,9 +68,19 @@ VulkanRenderer::~VulkanRenderer()
 
 bool VulkanRenderer::init( void* nativeLayer, uint32_t width, uint32_t height )
 {
+#if !defined( VK_USE_PLATFORM_METAL_EXT )
+    (void)nativeLayer;
+    (void)width;
+    (void)height;
+    std::fprintf( stderr, "init called but VK_USE_PLATFORM_METAL_EXT is not enabled; use initHeadless instead.\n" );
+    return false;
+#else
     if( initialized_ )
         return true;
 
+    if( !loadVulkanLibrary() )
+        return false;
+
     width_  = std::max( 1u, width );
     height_ = std::max( 1u, height );
 
@@ -71,12 +88,16 @@ bool VulkanRenderer::init( void* nativeLayer, uint32_t width, uint32_t height )
     createSurfaceFromMetalLayer( nativeLayer );
     pickPhysicalDevice();
     createDeviceAndQueues();
+    if( !createDeviceSubsystems() )
+        return false;
     createSwapchain( width_, height_ );
     createCommandResources();
     createSyncObjects();
 
     initialized_ = true;
+    invalidate(); // the first frame
     return true;
+#endif
 }
 
 bool VulkanRenderer::initGlfw( void* glfwWindow )
@@ -89,6 +110,9 @@ bool VulkanRenderer::initGlfw( void* glfwWindow )
     if( initialized_ )
         return true;
 
+    if( !loadVulkanLibrary() )
+        return false;
+
     GLFWwindow* window = reinterpret_cast<GLFWwindow*>( glfwWindow );
     int fbw            = 0;
     int fbh            = 0;
@@ -100,25 +124,679 @@ bool VulkanRenderer::initGlfw( void* glfwWindow )
     createSurfaceFromGlfw( glfwWindow );
     pickPhysicalDevice();
     createDeviceAndQueues();
+    if( !createDeviceSubsystems() )
+        return false;
     createSwapchain( width_, height_ );
     createCommandResources();
     createSyncObjects();
 
     initialized_ = true;
+    invalidate(); // the first frame
     return true;
 #endif
 }
 
+bool VulkanRenderer::initHeadless( uint32_t width, uint32_t height, VkFormat format )
+{
+    if( initialized_ )
+        return true;
+
+    if( !loadVulkanLibrary() )
+        return false;
+
+    width_           = std::max( 1u, width );
+    height_          = std::max( 1u, height );
+    headless_        = true;
+    offscreenFormat_ = format;
+
+    createInstanceHeadless();
+    pickPhysicalDevice();
+    createDeviceAndQueues();
+    if( !createDeviceSubsystems() )
+        return false;
+    createOffscreenTargets( width_, height_ );
+    createCommandResources();
+    createSyncObjects();
+
+    initialized_ = true;
+    invalidate(); // the first frame
+    return true;
+}
+
+bool VulkanRenderer::initExternal( const ExternalDevice& host )
+{
+    if( initialized_ )
+        return true;
+
+    if( host.instance == VK_NULL_HANDLE || host.physicalDevice == VK_NULL_HANDLE || host.device == VK_NULL_HANDLE ||
+        host.queue == VK_NULL_HANDLE )
+    {
+        std::fprintf( stderr, "initExternal needs the host's instance, physical device, device and queue.\n" );
+        return false;
+    }
+    if( host.framesInFlight == 0 || host.framesInFlight > kMaxFramesInFlight )
+    {
+        std::fprintf( stderr, "initExternal: the host has %u frames in flight; at most %u are supported.\n", host.framesInFlight,
+                      kMaxFramesInFlight );
+        return false;
+    }
+
+    // In dynamic builds this is the host's library too, already loaded; the functions are fetched from its objects.
+    if( !loadVulkanLibrary() )
+        return false;
+    loadVulkanInstanceFunctions( host.instance );
+    if( !dispatch_.load( host.device ) )
+    {
+        std::fprintf( stderr, "initExternal: the host's device is missing core Vulkan 1.1 functions.\n" );
+        return false;
+    }
+
+    external_       = true;
+    instance_       = host.instance;
+    physicalDevice_ = host.physicalDevice;
+    device_         = host.device;
+    framesInFlight_ = host.framesInFlight; // slots must map 1:1 to the host's
+
+    // One queue for everything, so the host's submit orders our uploads before its frames.
+    queue_               = host.queue;
+    queueFamilyIndex_    = host.queueFamilyIndex;
+    transferQueue_       = host.queue;
+    transferFamilyIndex_ = host.queueFamilyIndex;
+    computeQueue_        = host.queue;
+    computeFamilyIndex_  = host.queueFamilyIndex;
+
+    queryDevices();
+    deviceIndex_ = devices_.size();
+    for( const DeviceCaps& caps : devices_ )
+    {
+        if( caps.physicalDevice == physicalDevice_ )
+            deviceIndex_ = caps.index;
+    }
+    if( deviceIndex_ == devices_.size() )
+    {
+        std::fprintf( stderr, "initExternal: the host's physical device is not one its instance enumerates.\n" );
+        devices_.clear();
+        external_       = false;
+        instance_       = VK_NULL_HANDLE;
+        physicalDevice_ = VK_NULL_HANDLE;
+        device_         = VK_NULL_HANDLE;
+        deviceIndex_    = 0;
+        return false;
+    }
+
+    // The host chose the device extensions; none of the optional paths can be assumed.
+    dynamicRendering_   = false;
+    timelineSync_       = false;
+    descriptorIndexing_ = false;
+
+    if( !createDeviceSubsystems() )
+        return false;
+
+    initialized_ = true;
+    invalidate(); // the first frame
+    return true;
+}
+
+bool VulkanRenderer::createDeviceSubsystems()
+{
+    // A host's frames cannot wait on our semaphores; uploads then rely on sharing its queue.
+    allocator_.create( deviceCaps(), device_ );
+    uploads_.create( device_, dispatch_, allocator_, transferQueue_, transferFamilyIndex_, queueFamilyIndex_, uploadRingSize_, !external_ );
+    capture_.create( device_, dispatch_, allocator_, framesInFlight_ );
+    descriptors_.create( device_, framesInFlight_ );
+    if( !bindless_.create( device_, dispatch_, descriptors_, descriptorIndexing_, deviceCaps().descriptorIndexingLimits,
+                           bindlessImages_, bindlessBuffers_ ) )
+    {
+        std::fprintf( stderr, "VulkanRenderer: could not create the bindless descriptor table.\n" );
+
+        // Every destroy tolerates what was never created, so shutdown() unwinds the partial init, device and instance included.
+        initialized_ = true;
+        shutdown();
+        return false;
+    }
+    pipelineCache_.create( deviceCaps(), device_, pipelineCachePath_ );
+    shaders_.create( device_ );
+    return true;
+}
+
+void VulkanRenderer::beginExternalFrame( VkCommandBuffer cmd, uint32_t frameSlot )
+{
+    if( !initialized_ || !external_ )
+        return;
+
+    frameIndex_           = frameSlot % framesInFlight_;
+    FrameResources& frame = frames_[frameIndex_];
+
+    // The host only reuses a slot after its last frame finished, and frames finish in order.
+    completedFrames_ = std::max( completedFrames_, frame.submittedFrames );
+    collectGarbage();
+    capture_.deliver( completedFrames_ );
+    descriptors_.beginFrame( frameIndex_ );
+
+    uploads_.submit();
+    frameWaitSemaphores_.clear();
+    uploads_.acquire( cmd, frameNumber_ + 1, completedFrames_, frameWaitSemaphores_ ); // no semaphores in this mode
+
+    // Compute goes into the frame's own command buffer: there is no submit of ours to put it in.
+    if( !computeJobs_.empty() )
+    {
+        VkPipelineStageFlags dstStages = 0;
+        for( auto& job : computeJobs_ )
+        {
+            job.record( cmd );
+            dstStages |= job.dstStages;
+        }
+        computeJobs_.clear();
+
+        VkMemoryBarrier barrier{};
+        barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        dispatch_.vkCmdPipelineBarrier( cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                        dstStages != 0 ? dstStages : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0,
+                                        nullptr );
+    }
+
+    externalFrameOpen_ = true;
+}
+
+void VulkanRenderer::recordExternalFrame( VkCommandBuffer cmd, VkRenderPass renderPass, VkFormat colorFormat, VkExtent2D extent )
+{
+    if( !initialized_ || !external_ )
+        return;
+
+    if( !externalFrameOpen_ )
+    {
+        std::fprintf( stderr, "recordExternalFrame called without beginExternalFrame; ignoring.\n" );
+        return;
+    }
+    externalFrameOpen_ = false;
+    consumeFrameRequest();
+
+    // Borrowed for this frame, so that renderPass(), colorFormat() and extent() describe the host's target.
+    renderPass_      = renderPass;
+    swapchainFormat_ = colorFormat;
+    swapchainExtent_ = extent;
+    width_           = std::max( 1u, extent.width );
+    height_          = std::max( 1u, extent.height );
+
+    // The host's render pass is recorded inline, so jobs cannot go into secondaries; they run one after another.
+    for( auto& job : recordJobs_ )
+    {
+        job.record( cmd );
+    }
+    if( recordCallback_ )
+    {
+        recordCallback_( cmd );
+    }
+
+    ++frameNumber_;
+    frames_[frameIndex_].submittedFrames = frameNumber_;
+}
+
 void VulkanRenderer::setRecordCallback( RecordCallback cb )
 {
-    recordCallback_ = std::move( cb );
+    post( [this, cb = std::move( cb )]() mutable
+          {
+              recordCallback_ = std::move( cb );
+              invalidate();
+          } );
+}
+
+uint32_t VulkanRenderer::addRecordJob( RecordCallback job )
+{
+    const uint32_t id = nextRecordJobId_.fetch_add( 1, std::memory_order_relaxed );
+    post( [this, id, job = std::move( job )]() mutable
+          {
+              recordJobs_.push_back( { id, std::move( job ) } );
+              invalidate();
+          } );
+    return id;
+}
+
+void VulkanRenderer::removeRecordJob( uint32_t id )
+{
+    post( [this, id]
+          {
+              auto matches = [id]( const RecordJob& job ) { return job.id == id; };
+              recordJobs_.erase( std::remove_if( recordJobs_.begin(), recordJobs_.end(), matches ), recordJobs_.end() );
+              invalidate();
+          } );
+}
+
+void VulkanRenderer::clearRecordJobs()
+{
+    post( [this]
+          {
+              recordJobs_.clear();
+              invalidate();
+          } );
+}
+
+uint64_t VulkanRenderer::submitCompute( RecordCallback record, VkPipelineStageFlags dstStages )
+{
+    // The returned frame number is the render thread's, so this cannot simply be posted.
+    if( renderThreadActive_ && tlsRenderThreadOwner != this )
+    {
+        std::fprintf( stderr, "submitCompute called off the render thread while it runs; ignoring.\n" );
+        return 0;
+    }
+
+    computeJobs_.push_back( { std::move( record ), dstStages } );
+    return frameNumber_ + 1;
+}
+
+void VulkanRenderer::setRenderOnDemand( bool enabled )
+{
+    renderOnDemand_.store( enabled, std::memory_order_relaxed );
+
+    // Continuous mode draws everything anyway; leftover requests would only cost frames after switching back.
+    if( !enabled )
+    {
+        requestedFrames_.store( 0, std::memory_order_relaxed );
+    }
+
+    // Switching to continuous mode must get a sleeping render thread going.
+    if( renderThreadActive_ )
+    {
+        wakeRenderThread();
+    }
+}
+
+void VulkanRenderer::invalidate( uint32_t frames )
+{
+    uint32_t current = requestedFrames_.load( std::memory_order_relaxed );
+    while( current < frames && !requestedFrames_.compare_exchange_weak( current, frames, std::memory_order_relaxed ) )
+    {
+    }
+
+    if( renderThreadActive_ )
+    {
+        wakeRenderThread();
+    }
+}
+
+bool VulkanRenderer::startRenderThread()
+{
+    if( !initialized_ )
+    {
+        std::fprintf( stderr, "startRenderThread requires an initialized renderer.\n" );
+        return false;
+    }
+    if( external_ )
+    {
+        std::fprintf( stderr, "startRenderThread: in external mode the host's thread renders.\n" );
+        return false;
+    }
+    if( renderThreadActive_ )
+        return true;
+
+    renderThreadPoster_ = std::this_thread::get_id();
+    renderThreadActive_ = true;
+    renderThread_       = std::thread( [this] { renderThreadMain(); } );
+    return true;
+}
+
+void VulkanRenderer::stopRenderThread()
+{
+    if( !renderThreadActive_ )
+        return;
+
+    RenderCommand command;
+    command.type = RenderCommand::Type::Stop;
+    pushRenderCommand( std::move( command ) );
+    renderThread_.join();
+    renderThreadActive_ = false;
+}
+
+void VulkanRenderer::post( std::function<void()> fn )
+{
+    if( !renderThreadActive_ || tlsRenderThreadOwner == this )
+    {
+        fn();
+        return;
+    }
+
+    RenderCommand command;
+    command.type = RenderCommand::Type::Call;
+    command.call = std::move( fn );
+    pushRenderCommand( std::move( command ) );
+}
+
+void VulkanRenderer::pushRenderCommand( RenderCommand&& command )
+{
+    // The queue has a single producer; a second one (a record job, another app thread) would corrupt it.
+    if( std::this_thread::get_id() != renderThreadPoster_ )
+    {
+        std::fprintf( stderr, "VulkanRenderer: posted to the render thread from a thread other than the one that started it.\n" );
+        std::abort();
+    }
+
+    // The render thread drains the queue before every frame, so a full queue only lasts about a frame.
+    while( !renderCommands_.tryPush( std::move( command ) ) )
+    {
+        std::this_thread::yield();
+    }
+    wakeRenderThread();
+}
+
+void VulkanRenderer::wakeRenderThread()
+{
+    // Pairs with the fence in renderThreadMain(): either the render thread sees the new work before sleeping, or
+    // this sees it sleeping. Only then is the mutex needed.
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    if( renderThreadSleeping_.load( std::memory_order_relaxed ) )
+    {
+        std::lock_guard<std::mutex> lock( renderWakeMutex_ );
+        renderWake_.notify_one();
+    }
+}
+
+void VulkanRenderer::renderThreadMain()
+{
+    tlsRenderThreadOwner = this;
+
+    RenderCommand command;
+    for( ;; )
+    {
+        while( renderCommands_.tryPop( command ) )
+        {
+            switch( command.type )
+            {
+                case RenderCommand::Type::Resize:
+                    applyResize( command.width, command.height );
+                    break;
+                case RenderCommand::Type::Call:
+                    command.call();
+                    break;
+                case RenderCommand::Type::Stop:
+                    tlsRenderThreadOwner = nullptr;
+                    return;
+            }
+        }
+
+        if( needsFrame() )
+        {
+            drawFrame();
+            continue;
+        }
+
+        // Idle, but frames in flight still have deferred destruction and captures to hand out: poll gently.
+        if( completedFrames_ < frameNumber_ )
+        {
+            drawFrame();
+            std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock( renderWakeMutex_ );
+        renderThreadSleeping_.store( true, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        renderWake_.wait( lock, [this] { return !renderCommands_.empty() || needsFrame(); } );
+        renderThreadSleeping_.store( false, std::memory_order_relaxed );
+    }
+}
+
+bool VulkanRenderer::needsFrame() const
+{
+    if( !renderOnDemand_.load( std::memory_order_relaxed ) )
+        return true;
+
+    return requestedFrames_.load( std::memory_order_relaxed ) > 0 || swapchainDirty_ || !computeJobs_.empty() || capture_.hasPending() ||
+           uploads_.hasPending();
+}
+
+const DeviceCaps& VulkanRenderer::deviceCaps() const
+{
+    static const DeviceCaps none;
+    return deviceIndex_ < devices_.size() ? devices_[deviceIndex_] : none;
+}
+
+bool VulkanRenderer::captureSupported() const
+{
+    return wantCapture_ && !external_ && ( headless_ || swapchainTransferSrc_ ) && FrameCapture::texelSize( swapchainFormat_ ) != 0;
+}
+
+bool VulkanRenderer::requestCapture( CaptureCallback callback )
+{
+    if( !initialized_ || !captureSupported() )
+        return false;
+
+    post( [this, callback = std::move( callback )]() mutable { capture_.request( std::move( callback ) ); } );
+    return true;
+}
+
+void VulkanRenderer::setRecordThreadCount( uint32_t workers )
+{
+    if( initialized_ )
+    {
+        std::fprintf( stderr, "setRecordThreadCount must be called before init; ignoring.\n" );
+        return;
+    }
+
+    recordWorkers_ = workers;
+}
+
+void VulkanRenderer::setFramesInFlight( uint32_t count )
+{
+    if( initialized_ )
+    {
+        std::fprintf( stderr, "setFramesInFlight must be called before init; ignoring.\n" );
+        return;
+    }
+
+    framesInFlight_ = std::clamp( count, 1u, kMaxFramesInFlight );
+}
+
+void VulkanRenderer::setUploadRingSize( VkDeviceSize bytes )
+{
+    if( initialized_ )
+    {
+        std::fprintf( stderr, "setUploadRingSize must be called before init; ignoring.\n" );
+        return;
+    }
+
+    uploadRingSize_ = std::max<VkDeviceSize>( bytes, 64 * 1024 );
+}
+
+void VulkanRenderer::setDynamicRenderingEnabled( bool enabled )
+{
+    if( initialized_ )
+    {
+        std::fprintf( stderr, "setDynamicRenderingEnabled must be called before init; ignoring.\n" );
+        return;
+    }
+
+    wantDynamicRendering_ = enabled;
+}
+
+void VulkanRenderer::setCaptureEnabled( bool enabled )
+{
+    if( initialized_ )
+    {
+        std::fprintf( stderr, "setCaptureEnabled must be called before init; ignoring.\n" );
+        return;
+    }
+
+    wantCapture_ = enabled;
+}
+
+void VulkanRenderer::setTimelineSyncEnabled( bool enabled )
+{
+    if( initialized_ )
+    {
+        std::fprintf( stderr, "setTimelineSyncEnabled must be called before init; ignoring.\n" );
+        return;
+    }
+
+    wantTimelineSync_ = enabled;
+}
+
+void VulkanRenderer::setBindlessEnabled( bool enabled, uint32_t maxImages, uint32_t maxBuffers )
+{
+    if( initialized_ )
+    {
+        std::fprintf( stderr, "setBindlessEnabled must be called before init; ignoring.\n" );
+        return;
+    }
+
+    wantBindless_    = enabled;
+    bindlessImages_  = maxImages;
+    bindlessBuffers_ = maxBuffers;
+}
+
+void VulkanRenderer::setRequiredDeviceFeatures( const VkPhysicalDeviceFeatures& features )
+{
+    if( initialized_ )
+    {
+        std::fprintf( stderr, "setRequiredDeviceFeatures must be called before init; ignoring.\n" );
+        return;
+    }
+
+    requiredFeatures_ = features;
+}
+
+void VulkanRenderer::setPreferredDevice( std::string nameOrIndex )
+{
+    if( initialized_ )
+    {
+        std::fprintf( stderr, "setPreferredDevice must be called before init; ignoring.\n" );
+        return;
+    }
+
+    preferredDevice_ = std::move( nameOrIndex );
+}
+
+void VulkanRenderer::setPipelineCachePath( std::string path )
+{
+    if( initialized_ )
+    {
+        std::fprintf( stderr, "setPipelineCachePath must be called before init; ignoring.\n" );
+        return;
+    }
+
+    pipelineCachePath_ = std::move( path );
+}
+
+bool VulkanRenderer::savePipelineCache()
+{
+    return pipelineCache_.save();
+}
+
+void VulkanRenderer::setPresentPolicy( PresentPolicy policy )
+{
+    post( [this, policy]
+          {
+              if( policy == presentPolicy_ )
+                  return;
+
+              presentPolicy_ = policy;
+
+              // Takes effect through the regular (stall-free) swapchain recreation on the next frame.
+              if( initialized_ && !headless_ )
+              {
+                  swapchainDirty_ = true;
+              }
+          } );
+}
+
+void VulkanRenderer::setResizePolicy( const ResizePolicy& policy )
+{
+    post( [this, policy] { resizePolicy_ = policy; } );
+}
+
+void VulkanRenderer::resize( uint32_t width, uint32_t height )
+{
+    // The host's extent comes with every recordExternalFrame().
+    if( external_ )
+        return;
+
+    if( renderThreadActive_ && tlsRenderThreadOwner != this )
+    {
+        RenderCommand command;
+        command.type   = RenderCommand::Type::Resize;
+        command.width  = width;
+        command.height = height;
+        pushRenderCommand( std::move( command ) );
+        return;
+    }
+
+    applyResize( width, height );
+}
+
+void VulkanRenderer::applyResize( uint32_t width, uint32_t height )
+{
+    width  = std::max( 1u, width );
+    height = std::max( 1u, height );
+    if( width == width_ && height == height_ )
+        return;
+
+    width_          = width;
+    height_         = height;
+    swapchainDirty_ = true;
+    lastResize_     = FrameClock::now();
+    ++resizeStats_.resizeEvents;
+}
+
+void VulkanRenderer::markSwapchainDirty( bool outOfDate )
+{
+    // A stale swapchain reports suboptimal on every frame; only the first report starts the settle timer.
+    if( !swapchainDirty_ )
+    {
+        swapchainDirty_ = true;
+        lastResize_     = FrameClock::now();
+        ++resizeStats_.resizeEvents;
+    }
+    swapchainOutOfDate_ = swapchainOutOfDate_ || outOfDate;
 }
 
-void VulkanRenderer::resize( uint32_t width, uint32_t height )
+bool VulkanRenderer::applyPendingResize( double& recreateMs )
 {
-    width_          = std::max( 1u, width );
-    height_         = std::max( 1u, height );
-    swapchainDirty_ = true;
+    if( !swapchainDirty_ )
+        return true;
+
+    if( !headless_ )
+    {
+        const auto now             = FrameClock::now();
+        const bool settled         = now - lastResize_ >= std::chrono::milliseconds( resizePolicy_.settleMs );
+        const bool allowed         = now - lastRecreate_ >= std::chrono::milliseconds( resizePolicy_.minIntervalMs );
+        const bool canPresentStale = resizePolicy_.presentStale && !swapchainOutOfDate_;
+
+        // Settling only makes sense while something is on screen; without a usable stale swapchain, rebuild as soon
+        // as the rate cap allows.
+        if( !allowed || ( canPresentStale && !settled ) )
+        {
+            if( canPresentStale )
+            {
+                ++resizeStats_.staleFrames;
+                return true;
+            }
+            ++resizeStats_.skippedFrames;
+
+            // Only the rate cap holds the rebuild back here. Wait it out, so a caller driven by needsFrame() (the
+            // render thread, an app loop) does not spin until then.
+            std::this_thread::sleep_until( lastRecreate_ + std::chrono::milliseconds( resizePolicy_.minIntervalMs ) );
+            return false;
+        }
+    }
+
+    const auto tRecreate = FrameClock::now();
+    if( headless_ )
+    {
+        recreateOffscreenTargets();
+    }
+    else
+    {
+        recreateSwapchain();
+    }
+    lastRecreate_ = FrameClock::now();
+    recreateMs    = elapsedMs( tRecreate, lastRecreate_ );
+
+    ++resizeStats_.recreations;
+    resizeStats_.recreateMs = recreateMs;
+    swapchainDirty_         = false;
+    swapchainOutOfDate_     = false;
+    return true;
 }
 
 void VulkanRenderer::shutdown()
@@ -126,11 +804,43 @@ void VulkanRenderer::shutdown()
     if( !initialized_ )
         return;
 
+    stopRenderThread();
+
     vkDeviceWaitIdle( device_ );
 
+    // Everything submitted has finished, so recorded captures can still be handed out.
+    capture_.deliver( frameNumber_ );
+    flushDeletionQueue();
     destroySyncObjects();
     destroyCommandResources();
-    destroySwapchain();
+    if( external_ )
+    {
+        renderPass_ = VK_NULL_HANDLE; // the host's
+    }
+    else if( headless_ )
+    {
+        destroyOffscreenTargets();
+    }
+    else
+    {
+        destroySwapchain();
+    }
+
+    pipelineCache_.save();
+    pipelineCache_.destroy();
+    shaders_.destroy();
+    bindless_.destroy();
+    descriptors_.destroy();
+    capture_.destroy();
+    uploads_.destroy();
+    allocator_.destroy();
+
+    if( external_ )
+    {
+        // The host's; only forget them.
+        device_   = VK_NULL_HANDLE;
+        instance_ = VK_NULL_HANDLE;
+    }
 
     if( device_ != VK_NULL_HANDLE )
     {
@@ -150,16 +860,35 @@ void VulkanRenderer::shutdown()
         instance_ = VK_NULL_HANDLE;
     }
 
-    initialized_ = false;
+    // Physical device handles belong to the instance.
+    devices_.clear();
+    deviceIndex_    = 0;
+    physicalDevice_ = VK_NULL_HANDLE;
+
+    computeJobs_.clear();
+    frameTimings_.clear(); // a re-init must not report the previous device's frames
+
+    swapchainDirty_     = false;
+    swapchainOutOfDate_ = false;
+    resizeStats_        = {};
+    idleFrames_         = 0;
+    requestedFrames_.store( 0, std::memory_order_relaxed );
+
+    frameNumber_        = 0;
+    completedFrames_    = 0;
+    headless_           = false;
+    external_           = false;
+    externalFrameOpen_  = false;
+    dynamicRendering_   = false;
+    timelineSync_       = false;
+    descriptorIndexing_ = false;
+    dispatch_           = DeviceDispatch{};
+    initialized_        = false;
 }
 
-void VulkanRenderer::createInstanceForMetalSurface()
+void VulkanRenderer::createInstance( std::vector<const char*> extensions )
 {
-    std::vector<const char*> extensions;
-    extensions.push_back( VK_KHR_SURFACE_EXTENSION_NAME );
-    extensions.push_back( VK_EXT_METAL_SURFACE_EXTENSION_NAME );
-
-    if( hasInstanceExtension( VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME ) )
+    if( instanceExtensions().contains( VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME ) )
     {
         extensions.push_back( VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME );
     }
@@ -184,6 +913,18 @@ void VulkanRenderer::createInstanceForMetalSurface()
     }
 
     VK_CHECK( vkCreateInstance( &ci, nullptr, &instance_ ) );
+    loadVulkanInstanceFunctions( instance_ );
+}
+
+void VulkanRenderer::createInstanceForMetalSurface()
+{
+#if defined( VK_USE_PLATFORM_METAL_EXT )
+    std::vector<const char*> extensions;
+    extensions.push_back( VK_KHR_SURFACE_EXTENSION_NAME );
+    extensions.push_back( VK_EXT_METAL_SURFACE_EXTENSION_NAME );
+
+    createInstance( std::move( extensions ) );
+#endif
 }
 
 void VulkanRenderer::createInstanceForGlfw( void* glfwWindow )
@@ -213,43 +954,29 @@ void VulkanRenderer::createInstanceForGlfw( void* glfwWindow )
         extensions.push_back( glfwExts[i] );
     }
 
-    if( hasInstanceExtension( VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME ) )
-    {
-        extensions.push_back( VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME );
-    }
-
-    VkApplicationInfo appInfo{};
-    appInfo.sType              = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-    appInfo.pApplicationName   = "VulkanMoltenVKSample";
-    appInfo.applicationVersion = VK_MAKE_VERSION( 1, 0, 0 );
-    appInfo.pEngineName        = "None";
-    appInfo.engineVersion      = VK_MAKE_VERSION( 1, 0, 0 );
-    appInfo.apiVersion         = VK_API_VERSION_1_1;
-
-    VkInstanceCreateInfo ci{};
-    ci.sType                   = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-    ci.pApplicationInfo        = &appInfo;
-    ci.enabledExtensionCount   = static_cast<uint32_t>( extensions.size() );
-    ci.ppEnabledExtensionNames = extensions.data();
-
-    if( std::find( extensions.begin(), extensions.end(), VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME ) != extensions.end() )
-    {
-        ci.flags |= VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
-    }
-
-    VK_CHECK( vkCreateInstance( &ci, nullptr, &instance_ ) );
+    createInstance( std::move( extensions ) );
 #else
     (void)glfwWindow;
 #endif
 }
 
+void VulkanRenderer::createInstanceHeadless()
+{
+    // No WSI extensions: offscreen rendering needs nothing beyond core Vulkan.
+    createInstance( {} );
+}
+
 void VulkanRenderer::createSurfaceFromMetalLayer( void* nativeLayer )
 {
+#if defined( VK_USE_PLATFORM_METAL_EXT )
     VkMetalSurfaceCreateInfoEXT sci{};
     sci.sType  = VK_STRUCTURE_TYPE_METAL_SURFACE_CREATE_INFO_EXT;
     sci.pLayer = reinterpret_cast<CAMetalLayer*>( nativeLayer );
 
     VK_CHECK( vkCreateMetalSurfaceEXT( instance_, &sci, nullptr, &surface_ ) );
+#else
+    (void)nativeLayer;
+#endif
 }
 
 void VulkanRenderer::createSurfaceFromGlfw( void* glfwWindow )
@@ -262,81 +989,316 @@ void VulkanRenderer::createSurfaceFromGlfw( void* glfwWindow )
 #endif
 }
 
-void VulkanRenderer::pickPhysicalDevice()
+void VulkanRenderer::queryDevices()
 {
     uint32_t count = 0;
     VK_CHECK( vkEnumeratePhysicalDevices( instance_, &count, nullptr ) );
-    if( count == 0 )
+    std::vector<VkPhysicalDevice> handles( count );
+    VK_CHECK( vkEnumeratePhysicalDevices( instance_, &count, handles.data() ) );
+
+    devices_.clear();
+    devices_.reserve( count );
+    for( uint32_t i = 0; i < count; ++i )
+    {
+        devices_.push_back( DeviceCaps::query( handles[i], i ) );
+    }
+}
+
+bool VulkanRenderer::isDeviceSuitable( const DeviceCaps& caps, uint32_t& graphicsFamily ) const
+{
+    if( !headless_ && !caps.hasExtension( VK_KHR_SWAPCHAIN_EXTENSION_NAME ) )
+        return false;
+    if( !caps.supportsFeatures( requiredFeatures_ ) )
+        return false;
+
+    for( uint32_t i = 0; i < caps.queueFamilies.size(); ++i )
+    {
+        if( ( caps.queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT ) == 0 )
+            continue;
+
+        // Headless mode never presents, so any graphics queue will do.
+        VkBool32 presentSupported = headless_ ? VK_TRUE : VK_FALSE;
+        if( !headless_ )
+        {
+            VK_CHECK( vkGetPhysicalDeviceSurfaceSupportKHR( caps.physicalDevice, i, surface_, &presentSupported ) );
+        }
+        if( presentSupported )
+        {
+            graphicsFamily = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool matchesDevice( const DeviceCaps& caps, const std::string& nameOrIndex )
+{
+    char* end        = nullptr;
+    const long index = std::strtol( nameOrIndex.c_str(), &end, 10 );
+    if( end != nameOrIndex.c_str() && *end == '\0' )
+        return index >= 0 && static_cast<uint32_t>( index ) == caps.index;
+
+    auto lower = []( std::string s )
+    {
+        std::transform( s.begin(), s.end(), s.begin(), []( unsigned char c ) { return static_cast<char>( std::tolower( c ) ); } );
+        return s;
+    };
+    return lower( caps.name() ).find( lower( nameOrIndex ) ) != std::string::npos;
+}
+
+void VulkanRenderer::pickPhysicalDevice()
+{
+    queryDevices();
+    if( devices_.empty() )
     {
         std::fprintf( stderr, "No Vulkan physical devices found.\n" );
         std::abort();
     }
 
-    std::vector<VkPhysicalDevice> devices( count );
-    VK_CHECK( vkEnumeratePhysicalDevices( instance_, &count, devices.data() ) );
+    std::string preferred = preferredDevice_;
+    if( preferred.empty() )
+    {
+        if( const char* env = std::getenv( "VK_RENDERER_DEVICE" ) )
+            preferred = env;
+    }
 
-    for( auto pd : devices )
+    bool found              = false;
+    uint64_t bestScore      = 0;
+    uint32_t graphicsFamily = 0;
+    for( size_t i = 0; i < devices_.size(); ++i )
     {
-        if( !hasDeviceExtension( pd, VK_KHR_SWAPCHAIN_EXTENSION_NAME ) )
+        if( !isDeviceSuitable( devices_[i], graphicsFamily ) )
             continue;
 
-        uint32_t qCount = 0;
-        vkGetPhysicalDeviceQueueFamilyProperties( pd, &qCount, nullptr );
-        std::vector<VkQueueFamilyProperties> qProps( qCount );
-        vkGetPhysicalDeviceQueueFamilyProperties( pd, &qCount, qProps.data() );
-
-        for( uint32_t i = 0; i < qCount; ++i )
+        if( !preferred.empty() && matchesDevice( devices_[i], preferred ) )
         {
-            if( ( qProps[i].queueFlags & VK_QUEUE_GRAPHICS_BIT ) == 0 )
-                continue;
+            found             = true;
+            deviceIndex_      = i;
+            queueFamilyIndex_ = graphicsFamily;
+            break;
+        }
 
-            VkBool32 presentSupported = VK_FALSE;
-            VK_CHECK( vkGetPhysicalDeviceSurfaceSupportKHR( pd, i, surface_, &presentSupported ) );
-            if( presentSupported )
-            {
-                physicalDevice_   = pd;
-                queueFamilyIndex_ = i;
-                return;
-            }
+        // + 1 so that a device of unknown type with no device-local heap still beats "none found".
+        const uint64_t score = scoreDevice( devices_[i] ) + 1;
+        if( score > bestScore )
+        {
+            found             = true;
+            bestScore         = score;
+            deviceIndex_      = i;
+            queueFamilyIndex_ = graphicsFamily;
         }
     }
 
-    std::fprintf( stderr, "No suitable Vulkan physical device found.\n" );
-    std::abort();
+    if( !found )
+    {
+        std::fprintf( stderr, "No suitable Vulkan physical device found.\n" );
+        std::abort();
+    }
+
+    if( !preferred.empty() && !matchesDevice( devices_[deviceIndex_], preferred ) )
+    {
+        std::fprintf( stderr, "Preferred device \"%s\" not found or unsuitable; using %s.\n", preferred.c_str(), devices_[deviceIndex_].name() );
+    }
+
+    physicalDevice_ = devices_[deviceIndex_].physicalDevice;
 }
 
 void VulkanRenderer::createDeviceAndQueues()
 {
-    float prio = 1.0f;
+    const DeviceCaps& caps                             = devices_[deviceIndex_];
+    const std::vector<VkQueueFamilyProperties>& qProps = caps.queueFamilies;
+    const uint32_t qCount                              = static_cast<uint32_t>( qProps.size() );
+
+    // Uploads prefer a transfer-only family (a DMA engine that runs alongside rendering), then any non-graphics
+    // family with transfer support, then a second queue of the graphics family, and finally share the graphics queue.
+    transferFamilyIndex_  = queueFamilyIndex_;
+    uint32_t transferRank = 0;
+    for( uint32_t i = 0; i < qCount; ++i )
+    {
+        const VkQueueFlags flags = qProps[i].queueFlags;
+        if( i == queueFamilyIndex_ || ( flags & VK_QUEUE_GRAPHICS_BIT ) || !( flags & VK_QUEUE_TRANSFER_BIT ) )
+            continue;
+
+        const uint32_t rank = ( flags & VK_QUEUE_COMPUTE_BIT ) ? 1 : 2;
+        if( rank > transferRank )
+        {
+            transferRank         = rank;
+            transferFamilyIndex_ = i;
+        }
+    }
+
+    // Async compute prefers a compute family without graphics, ideally not the one uploads use, so dispatches overlap
+    // rendering. Without one, compute shares the graphics queue.
+    computeFamilyIndex_  = queueFamilyIndex_;
+    uint32_t computeRank = 0;
+    for( uint32_t i = 0; i < qCount; ++i )
+    {
+        const VkQueueFlags flags = qProps[i].queueFlags;
+        if( i == queueFamilyIndex_ || ( flags & VK_QUEUE_GRAPHICS_BIT ) || !( flags & VK_QUEUE_COMPUTE_BIT ) )
+            continue;
+
+        const uint32_t rank = i == transferFamilyIndex_ ? 1 : 2;
+        if( rank > computeRank )
+        {
+            computeRank         = rank;
+            computeFamilyIndex_ = i;
+        }
+    }
+
+    // Each role takes the next queue of its family; once a family runs out, roles share its last queue.
+    std::vector<uint32_t> familyQueues( qCount, 0 );
+    auto claimQueue = [&]( uint32_t family )
+    {
+        const uint32_t index = std::min( familyQueues[family], qProps[family].queueCount - 1 );
+        familyQueues[family] = index + 1;
+        return index;
+    };
+    const uint32_t graphicsQueueIndex = claimQueue( queueFamilyIndex_ );
+    const uint32_t transferQueueIndex = claimQueue( transferFamilyIndex_ );
+    const uint32_t computeQueueIndex  = computeFamilyIndex_ == queueFamilyIndex_ ? graphicsQueueIndex : claimQueue( computeFamilyIndex_ );
+
+    const float prios[3] = { 1.0f, 1.0f, 1.0f };
+
+    std::vector<VkDeviceQueueCreateInfo> qcis;
+    for( uint32_t i = 0; i < qCount; ++i )
+    {
+        if( familyQueues[i] == 0 )
+            continue;
 
-    VkDeviceQueueCreateInfo qci{};
-    qci.sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    qci.queueFamilyIndex = queueFamilyIndex_;
-    qci.queueCount       = 1;
-    qci.pQueuePriorities = &prio;
+        VkDeviceQueueCreateInfo qci{};
+        qci.sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        qci.queueFamilyIndex = i;
+        qci.queueCount       = familyQueues[i];
+        qci.pQueuePriorities = prios;
+        qcis.push_back( qci );
+    }
 
     std::vector<const char*> devExts;
-    devExts.push_back( VK_KHR_SWAPCHAIN_EXTENSION_NAME );
+    if( !headless_ )
+    {
+        devExts.push_back( VK_KHR_SWAPCHAIN_EXTENSION_NAME );
+    }
 
     // Use literal to avoid header/version pitfalls
     static constexpr const char* kPortabilitySubset = "VK_KHR_portability_subset";
-    if( hasDeviceExtension( physicalDevice_, kPortabilitySubset ) )
+    if( caps.hasExtension( kPortabilitySubset ) )
     {
         devExts.push_back( kPortabilitySubset );
     }
 
+    // The instance targets Vulkan 1.1, so dynamic rendering comes from the KHR extension (and its dependencies, which
+    // are core only from 1.2) even on 1.3 devices.
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+    dynamicRenderingFeatures.sType            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+
+    dynamicRendering_ = wantDynamicRendering_ && caps.hasExtension( VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME ) &&
+                        caps.hasExtension( VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME ) &&
+                        caps.hasExtension( VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME ) && caps.dynamicRendering.dynamicRendering == VK_TRUE;
+
+    if( dynamicRendering_ )
+    {
+        devExts.push_back( VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME );
+        devExts.push_back( VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME );
+        devExts.push_back( VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME );
+    }
+    else if( wantDynamicRendering_ )
+    {
+        std::fprintf( stderr, "VK_KHR_dynamic_rendering not supported; using the render pass path.\n" );
+    }
+
+    // Same story for timeline semaphores, core only from 1.2.
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+    timelineFeatures.sType             = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+    timelineFeatures.timelineSemaphore = VK_TRUE;
+
+    timelineSync_ = wantTimelineSync_ && caps.hasExtension( VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME ) &&
+                    caps.timelineSemaphore.timelineSemaphore == VK_TRUE;
+
+    if( timelineSync_ )
+    {
+        devExts.push_back( VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME );
+    }
+    else if( wantTimelineSync_ )
+    {
+        std::fprintf( stderr, "VK_KHR_timeline_semaphore not supported; using per-frame fences.\n" );
+    }
+
+    // And for descriptor indexing. The bindless table needs update-after-bind for the buffer and image arrays,
+    // partially bound and variable-count bindings; non-uniform indexing is enabled when present but not required.
+    const VkPhysicalDeviceDescriptorIndexingFeaturesEXT& indexing = caps.descriptorIndexing;
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+    indexingFeatures.sType                                         = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    indexingFeatures.runtimeDescriptorArray                        = VK_TRUE;
+    indexingFeatures.descriptorBindingPartiallyBound               = VK_TRUE;
+    indexingFeatures.descriptorBindingVariableDescriptorCount      = VK_TRUE;
+    indexingFeatures.descriptorBindingUpdateUnusedWhilePending     = VK_TRUE;
+    indexingFeatures.descriptorBindingSampledImageUpdateAfterBind  = VK_TRUE;
+    indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    indexingFeatures.shaderSampledImageArrayNonUniformIndexing     = indexing.shaderSampledImageArrayNonUniformIndexing;
+    indexingFeatures.shaderStorageBufferArrayNonUniformIndexing    = indexing.shaderStorageBufferArrayNonUniformIndexing;
+
+    descriptorIndexing_ = wantBindless_ && caps.hasExtension( VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME ) &&
+                          indexing.runtimeDescriptorArray == VK_TRUE && indexing.descriptorBindingPartiallyBound == VK_TRUE &&
+                          indexing.descriptorBindingVariableDescriptorCount == VK_TRUE &&
+                          indexing.descriptorBindingUpdateUnusedWhilePending == VK_TRUE &&
+                          indexing.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE &&
+                          indexing.descriptorBindingStorageBufferUpdateAfterBind == VK_TRUE;
+
+    if( descriptorIndexing_ )
+    {
+        // Its dependency VK_KHR_maintenance3 is core in 1.1; devices older than that list it separately.
+        if( caps.hasExtension( VK_KHR_MAINTENANCE_3_EXTENSION_NAME ) )
+        {
+            devExts.push_back( VK_KHR_MAINTENANCE_3_EXTENSION_NAME );
+        }
+        devExts.push_back( VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME );
+    }
+    else if( wantBindless_ )
+    {
+        std::fprintf( stderr, "VK_EXT_descriptor_indexing not supported; binding a descriptor set per draw.\n" );
+    }
+
+    const void* featureChain = nullptr;
+    if( dynamicRendering_ )
+    {
+        dynamicRenderingFeatures.pNext = const_cast<void*>( featureChain );
+        featureChain                   = &dynamicRenderingFeatures;
+    }
+    if( timelineSync_ )
+    {
+        timelineFeatures.pNext = const_cast<void*>( featureChain );
+        featureChain           = &timelineFeatures;
+    }
+    if( descriptorIndexing_ )
+    {
+        indexingFeatures.pNext = const_cast<void*>( featureChain );
+        featureChain           = &indexingFeatures;
+    }
+
     VkDeviceCreateInfo dci{};
     dci.sType                   = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    dci.queueCreateInfoCount    = 1;
-    dci.pQueueCreateInfos       = &qci;
+    dci.pNext                   = featureChain;
+    dci.queueCreateInfoCount    = static_cast<uint32_t>( qcis.size() );
+    dci.pQueueCreateInfos       = qcis.data();
     dci.enabledExtensionCount   = static_cast<uint32_t>( devExts.size() );
     dci.ppEnabledExtensionNames = devExts.data();
+    dci.pEnabledFeatures        = &requiredFeatures_;
 
     VK_CHECK( vkCreateDevice( physicalDevice_, &dci, nullptr, &device_ ) );
-    vkGetDeviceQueue( device_, queueFamilyIndex_, 0, &queue_ );
+    if( !dispatch_.load( device_ ) )
+    {
+        std::fprintf( stderr, "Device is missing core Vulkan 1.1 functions.\n" );
+        std::abort();
+    }
+
+    vkGetDeviceQueue( device_, queueFamilyIndex_, graphicsQueueIndex, &queue_ );
+    vkGetDeviceQueue( device_, transferFamilyIndex_, transferQueueIndex, &transferQueue_ );
+    vkGetDeviceQueue( device_, computeFamilyIndex_, computeQueueIndex, &computeQueue_ );
 }
 
-void VulkanRenderer::createSwapchain( uint32_t width, uint32_t height )
+void VulkanRenderer::createSwapchain( uint32_t width, uint32_t height, VkSwapchainKHR oldSwapchain )
 {
     VkSurfaceCapabilitiesKHR caps{};
     VK_CHECK( vkGetPhysicalDeviceSurfaceCapabilitiesKHR( physicalDevice_, surface_, &caps ) );
@@ -356,6 +1318,21 @@ void VulkanRenderer::createSwapchain( uint32_t width, uint32_t height )
         }
     }
 
+    uint32_t modeCount = 0;
+    VK_CHECK( vkGetPhysicalDeviceSurfacePresentModesKHR( physicalDevice_, surface_, &modeCount, nullptr ) );
+    std::vector<VkPresentModeKHR> modes( modeCount );
+    VK_CHECK( vkGetPhysicalDeviceSurfacePresentModesKHR( physicalDevice_, surface_, &modeCount, modes.data() ) );
+
+    VkPresentModeKHR chosenMode = VK_PRESENT_MODE_FIFO_KHR;
+    for( auto candidate : presentModePreference( presentPolicy_ ) )
+    {
+        if( std::find( modes.begin(), modes.end(), candidate ) != modes.end() )
+        {
+            chosenMode = candidate;
+            break;
+        }
+    }
+
     VkExtent2D extent{};
     if( caps.currentExtent.width != 0xFFFFFFFFu )
     {
@@ -367,7 +1344,8 @@ void VulkanRenderer::createSwapchain( uint32_t width, uint32_t height )
         extent.height = std::clamp( height, caps.minImageExtent.height, caps.maxImageExtent.height );
     }
 
-    uint32_t minImages = std::max( 2u, caps.minImageCount );
+    // Mailbox only beats FIFO if there is a spare image to render into while one is queued and one is on screen.
+    uint32_t minImages = std::max( chosenMode == VK_PRESENT_MODE_MAILBOX_KHR ? 3u : 2u, caps.minImageCount );
     if( caps.maxImageCount > 0 )
     {
         minImages = std::min( minImages, caps.maxImageCount );
@@ -389,6 +1367,15 @@ void VulkanRenderer::createSwapchain( uint32_t width, uint32_t height )
         }
     }
 
+    // Transfer source usage lets requestCapture() read the images back. Only on request: on MoltenVK it makes the
+    // layer's drawables non-framebufferOnly.
+    swapchainTransferSrc_   = wantCapture_ && ( caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT ) != 0;
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if( swapchainTransferSrc_ )
+    {
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+
     VkSwapchainCreateInfoKHR sci{};
     sci.sType            = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
     sci.surface          = surface_;
@@ -397,20 +1384,29 @@ void VulkanRenderer::createSwapchain( uint32_t width, uint32_t height )
     sci.imageColorSpace  = chosenFormat.colorSpace;
     sci.imageExtent      = extent;
     sci.imageArrayLayers = 1;
-    sci.imageUsage       = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    sci.imageUsage       = usage;
     sci.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
     sci.preTransform     = ( caps.supportedTransforms & VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR ) ? VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR
                                                                                                 : caps.currentTransform;
     sci.compositeAlpha   = compositeAlpha;
-    sci.presentMode      = VK_PRESENT_MODE_FIFO_KHR;
+    sci.presentMode      = chosenMode;
     sci.clipped          = VK_TRUE;
-    sci.oldSwapchain     = VK_NULL_HANDLE;
+    sci.oldSwapchain     = oldSwapchain;
 
     VK_CHECK( vkCreateSwapchainKHR( device_, &sci, nullptr, &swapchain_ ) );
 
+    // The render pass only depends on the format, so it survives resizes. A format change (e.g. moving the
+    // window to a display with a different native format) needs a new one.
+    if( renderPass_ != VK_NULL_HANDLE && chosenFormat.format != swapchainFormat_ )
+    {
+        deferDestroy( [device = device_, renderPass = renderPass_] { vkDestroyRenderPass( device, renderPass, nullptr ); } );
+        renderPass_ = VK_NULL_HANDLE;
+    }
+
     swapchainFormat_        = chosenFormat.format;
     swapchainExtent_        = extent;
     swapchainMinImageCount_ = minImages;
+    presentMode_            = chosenMode;
 
     uint32_t imageCount = 0;
     VK_CHECK( vkGetSwapchainImagesKHR( device_, swapchain_, &imageCount, nullptr ) );
@@ -434,6 +1430,16 @@ void VulkanRenderer::createSwapchain( uint32_t width, uint32_t height )
         VK_CHECK( vkCreateImageView( device_, &ivci, nullptr, &swapchainImageViews_[i] ) );
     }
 
+    VkSemaphoreCreateInfo semci{};
+    semci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    renderFinished_.resize( imageCount, VK_NULL_HANDLE );
+    for( uint32_t i = 0; i < imageCount; ++i )
+    {
+        VK_CHECK( vkCreateSemaphore( device_, &semci, nullptr, &renderFinished_[i] ) );
+    }
+    imageFrames_.assign( imageCount, 0 );
+
     createRenderPass();
     createFramebuffers();
 }
@@ -443,6 +1449,16 @@ void VulkanRenderer::destroySwapchain()
     destroyFramebuffers();
     destroyRenderPass();
 
+    for( auto sem : renderFinished_ )
+    {
+        if( sem != VK_NULL_HANDLE )
+        {
+            vkDestroySemaphore( device_, sem, nullptr );
+        }
+    }
+    renderFinished_.clear();
+    imageFrames_.clear();
+
     for( auto view : swapchainImageViews_ )
     {
         if( view != VK_NULL_HANDLE )
@@ -464,9 +1480,141 @@ void VulkanRenderer::destroySwapchain()
     swapchainMinImageCount_ = 2;
 }
 
+void VulkanRenderer::recreateSwapchain()
+{
+    // Frames still in flight may reference the current views, framebuffers and semaphores, so they are
+    // retired through the deletion queue instead of idling the device. The old swapchain is handed to the
+    // new one, which lets the presentation engine recycle its resources, and is destroyed the same way.
+    VkSwapchainKHR oldSwapchain = swapchain_;
+
+    deferDestroy( [device = device_, views = swapchainImageViews_, framebuffers = framebuffers_, semaphores = renderFinished_]
+                  {
+                      for( auto fb : framebuffers )
+                          vkDestroyFramebuffer( device, fb, nullptr );
+                      for( auto view : views )
+                          vkDestroyImageView( device, view, nullptr );
+                      for( auto sem : semaphores )
+                          vkDestroySemaphore( device, sem, nullptr );
+                  } );
+
+    framebuffers_.clear();
+    swapchainImageViews_.clear();
+    swapchainImages_.clear();
+    renderFinished_.clear();
+    imageFrames_.clear();
+    swapchain_ = VK_NULL_HANDLE;
+
+    createSwapchain( width_, height_, oldSwapchain );
+
+    deferDestroy( [device = device_, oldSwapchain] { vkDestroySwapchainKHR( device, oldSwapchain, nullptr ); } );
+}
+
+void VulkanRenderer::createOffscreenTargets( uint32_t width, uint32_t height )
+{
+    VkFormatProperties formatProps{};
+    vkGetPhysicalDeviceFormatProperties( physicalDevice_, offscreenFormat_, &formatProps );
+    if( ( formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT ) == 0 )
+    {
+        std::fprintf( stderr, "Headless format %d is not usable as a color attachment.\n", (int)offscreenFormat_ );
+        std::abort();
+    }
+
+    swapchainFormat_        = offscreenFormat_;
+    swapchainExtent_        = { width, height };
+    swapchainMinImageCount_ = framesInFlight_;
+
+    // One target per frame in flight, so frame N+1 never renders into an image the GPU is still writing.
+    swapchainImages_.resize( framesInFlight_, VK_NULL_HANDLE );
+    swapchainImageViews_.resize( framesInFlight_, VK_NULL_HANDLE );
+    offscreenMemory_.resize( framesInFlight_, nullptr );
+
+    for( uint32_t i = 0; i < framesInFlight_; ++i )
+    {
+        VkImageCreateInfo ici{};
+        ici.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        ici.imageType     = VK_IMAGE_TYPE_2D;
+        ici.format        = offscreenFormat_;
+        ici.extent        = { width, height, 1 };
+        ici.mipLevels     = 1;
+        ici.arrayLayers   = 1;
+        ici.samples       = VK_SAMPLE_COUNT_1_BIT;
+        ici.tiling        = VK_IMAGE_TILING_OPTIMAL;
+        ici.usage         = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        ici.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
+        ici.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        // Sub-allocated, so resizing churns ranges inside a block rather than driver allocations.
+        swapchainImages_[i] = allocator_.createImage( ici, GpuMemoryUsage::GpuOnly, &offscreenMemory_[i] );
+        if( swapchainImages_[i] == VK_NULL_HANDLE )
+        {
+            std::fprintf( stderr, "Out of device memory for the %ux%u headless target.\n", width, height );
+            std::abort();
+        }
+
+        VkImageViewCreateInfo ivci{};
+        ivci.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        ivci.image                           = swapchainImages_[i];
+        ivci.viewType                        = VK_IMAGE_VIEW_TYPE_2D;
+        ivci.format                          = offscreenFormat_;
+        ivci.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        ivci.subresourceRange.baseMipLevel   = 0;
+        ivci.subresourceRange.levelCount     = 1;
+        ivci.subresourceRange.baseArrayLayer = 0;
+        ivci.subresourceRange.layerCount     = 1;
+        VK_CHECK( vkCreateImageView( device_, &ivci, nullptr, &swapchainImageViews_[i] ) );
+    }
+
+    createRenderPass();
+    createFramebuffers();
+}
+
+void VulkanRenderer::recreateOffscreenTargets()
+{
+    deferDestroy( [device = device_, allocator = &allocator_, views = swapchainImageViews_, framebuffers = framebuffers_,
+                   images = swapchainImages_, memory = offscreenMemory_]
+                  {
+                      for( auto fb : framebuffers )
+                          vkDestroyFramebuffer( device, fb, nullptr );
+                      for( auto view : views )
+                          vkDestroyImageView( device, view, nullptr );
+                      for( size_t i = 0; i < images.size(); ++i )
+                          allocator->destroyImage( images[i], memory[i] );
+                  } );
+
+    framebuffers_.clear();
+    swapchainImageViews_.clear();
+    swapchainImages_.clear();
+    offscreenMemory_.clear();
+
+    // The format is fixed in headless mode, so the render pass is kept.
+    createOffscreenTargets( width_, height_ );
+}
+
+void VulkanRenderer::destroyOffscreenTargets()
+{
+    destroyFramebuffers();
+    destroyRenderPass();
+
+    for( size_t i = 0; i < swapchainImages_.size(); ++i )
+    {
+        if( swapchainImageViews_[i] != VK_NULL_HANDLE )
+        {
+            vkDestroyImageView( device_, swapchainImageViews_[i], nullptr );
+        }
+        allocator_.destroyImage( swapchainImages_[i], offscreenMemory_[i] );
+    }
+    swapchainImageViews_.clear();
+    swapchainImages_.clear();
+    offscreenMemory_.clear();
+
+    swapchainFormat_        = VK_FORMAT_UNDEFINED;
+    swapchainExtent_        = {};
+    swapchainMinImageCount_ = 2;
+}
+
 void VulkanRenderer::createRenderPass()
 {
-    if( renderPass_ != VK_NULL_HANDLE )
+    if( renderPass_ != VK_NULL_HANDLE || dynamicRendering_ )
         return;
 
     VkAttachmentDescription colorAttachment{};
@@ -477,7 +1625,8 @@ void VulkanRenderer::createRenderPass()
     colorAttachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout    = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // Offscreen targets are left ready for copies/readback instead of presentation.
+    colorAttachment.finalLayout    = headless_ ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     VkAttachmentReference colorRef{};
     colorRef.attachment = 0;
@@ -519,6 +1668,9 @@ void VulkanRenderer::destroyRenderPass()
 
 void VulkanRenderer::createFramebuffers()
 {
+    if( dynamicRendering_ )
+        return; // frames render straight into the image views
+
     framebuffers_.resize( swapchainImageViews_.size(), VK_NULL_HANDLE );
 
     for( size_t i = 0; i < swapchainImageViews_.size(); ++i )
@@ -552,174 +1704,799 @@ void VulkanRenderer::destroyFramebuffers()
 
 void VulkanRenderer::createCommandResources()
 {
-    if( commandPool_ == VK_NULL_HANDLE )
+    VkCommandPoolCreateInfo cpci{};
+    cpci.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cpci.queueFamilyIndex = queueFamilyIndex_;
+    cpci.flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    for( uint32_t i = 0; i < framesInFlight_; ++i )
     {
-        VkCommandPoolCreateInfo cpci{};
-        cpci.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-        cpci.queueFamilyIndex = queueFamilyIndex_;
-        cpci.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-        VK_CHECK( vkCreateCommandPool( device_, &cpci, nullptr, &commandPool_ ) );
-    }
+        FrameResources& frame = frames_[i];
+
+        VK_CHECK( vkCreateCommandPool( device_, &cpci, nullptr, &frame.commandPool ) );
 
-    commandBuffers_.resize( swapchainImages_.size(), VK_NULL_HANDLE );
+        VkCommandBufferAllocateInfo cbai{};
+        cbai.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cbai.commandPool        = frame.commandPool;
+        cbai.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cbai.commandBufferCount = 1;
+        VK_CHECK( vkAllocateCommandBuffers( device_, &cbai, &frame.commandBuffer ) );
 
-    VkCommandBufferAllocateInfo cbai{};
-    cbai.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    cbai.commandPool        = commandPool_;
-    cbai.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    cbai.commandBufferCount = static_cast<uint32_t>( commandBuffers_.size() );
-    VK_CHECK( vkAllocateCommandBuffers( device_, &cbai, commandBuffers_.data() ) );
+        VkCommandPoolCreateInfo computePci = cpci;
+        computePci.queueFamilyIndex        = computeFamilyIndex_;
+        VK_CHECK( vkCreateCommandPool( device_, &computePci, nullptr, &frame.computePool ) );
+
+        cbai.commandPool = frame.computePool;
+        VK_CHECK( vkAllocateCommandBuffers( device_, &cbai, &frame.computeBuffer ) );
+    }
 }
 
-void VulkanRenderer::destroyCommandResources()
+void VulkanRenderer::startRecordThreads()
 {
-    if( !commandBuffers_.empty() && commandPool_ != VK_NULL_HANDLE )
+    if( !frames_[0].threadCommands.empty() )
+        return;
+
+    workerPool_.start( recordWorkers_ );
+
+    VkCommandPoolCreateInfo cpci{};
+    cpci.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cpci.queueFamilyIndex = queueFamilyIndex_;
+    cpci.flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    // Command pools are externally synchronized, so every recording thread gets its own per frame slot.
+    for( uint32_t i = 0; i < framesInFlight_; ++i )
     {
-        vkFreeCommandBuffers( device_, commandPool_, static_cast<uint32_t>( commandBuffers_.size() ), commandBuffers_.data() );
-        commandBuffers_.clear();
+        frames_[i].threadCommands.resize( workerPool_.threadCount() );
+        for( auto& commands : frames_[i].threadCommands )
+        {
+            VK_CHECK( vkCreateCommandPool( device_, &cpci, nullptr, &commands.pool ) );
+        }
     }
+}
 
-    if( commandPool_ != VK_NULL_HANDLE )
+void VulkanRenderer::destroyCommandResources()
+{
+    workerPool_.stop();
+
+    for( auto& frame : frames_ )
     {
-        vkDestroyCommandPool( device_, commandPool_, nullptr );
-        commandPool_ = VK_NULL_HANDLE;
+        // Destroying the pool frees its command buffers.
+        if( frame.commandPool != VK_NULL_HANDLE )
+        {
+            vkDestroyCommandPool( device_, frame.commandPool, nullptr );
+            frame.commandPool = VK_NULL_HANDLE;
+        }
+        frame.commandBuffer = VK_NULL_HANDLE;
+
+        if( frame.computePool != VK_NULL_HANDLE )
+        {
+            vkDestroyCommandPool( device_, frame.computePool, nullptr );
+            frame.computePool = VK_NULL_HANDLE;
+        }
+        frame.computeBuffer = VK_NULL_HANDLE;
+
+        for( auto& commands : frame.threadCommands )
+        {
+            vkDestroyCommandPool( device_, commands.pool, nullptr );
+        }
+        frame.threadCommands.clear();
     }
+
+    secondaryBuffers_.clear();
 }
 
 void VulkanRenderer::createSyncObjects()
 {
     VkSemaphoreCreateInfo sci{};
     sci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-    VK_CHECK( vkCreateSemaphore( device_, &sci, nullptr, &imageAvailable_ ) );
-    VK_CHECK( vkCreateSemaphore( device_, &sci, nullptr, &renderFinished_ ) );
 
     VkFenceCreateInfo fci{};
     fci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fci.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    VK_CHECK( vkCreateFence( device_, &fci, nullptr, &inFlight_ ) );
+
+    for( uint32_t i = 0; i < framesInFlight_; ++i )
+    {
+        VK_CHECK( vkCreateSemaphore( device_, &sci, nullptr, &frames_[i].imageAvailable ) );
+        VK_CHECK( vkCreateSemaphore( device_, &sci, nullptr, &frames_[i].computeFinished ) );
+        if( !timelineSync_ )
+        {
+            VK_CHECK( vkCreateFence( device_, &fci, nullptr, &frames_[i].inFlight ) );
+        }
+    }
+
+    if( timelineSync_ )
+    {
+        // Starts at the last submitted frame so that the counter and frameNumber_ agree from the first frame on.
+        VkSemaphoreTypeCreateInfoKHR stci{};
+        stci.sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+        stci.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+        stci.initialValue  = frameNumber_;
+
+        VkSemaphoreCreateInfo tci{};
+        tci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        tci.pNext = &stci;
+        VK_CHECK( vkCreateSemaphore( device_, &tci, nullptr, &frameTimeline_ ) );
+    }
+
+    frameIndex_ = 0;
+
+    createTimingQueries();
+}
+
+void VulkanRenderer::createTimingQueries()
+{
+    const DeviceCaps& caps = devices_[deviceIndex_];
+
+    timestampValidBits_ = caps.queueFamilies[queueFamilyIndex_].timestampValidBits;
+    timestampPeriod_    = caps.properties.limits.timestampPeriod;
+    if( timestampValidBits_ == 0 || timestampPeriod_ <= 0.0f )
+        return; // GPU timings are reported as unavailable
+
+    // Two timestamps (render pass begin/end) per frame slot.
+    VkQueryPoolCreateInfo qpci{};
+    qpci.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    qpci.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+    qpci.queryCount = 2 * kMaxFramesInFlight;
+    VK_CHECK( vkCreateQueryPool( device_, &qpci, nullptr, &timestampPool_ ) );
 }
 
 void VulkanRenderer::destroySyncObjects()
 {
-    if( inFlight_ != VK_NULL_HANDLE )
+    if( timestampPool_ != VK_NULL_HANDLE )
+    {
+        vkDestroyQueryPool( device_, timestampPool_, nullptr );
+        timestampPool_ = VK_NULL_HANDLE;
+    }
+
+    if( frameTimeline_ != VK_NULL_HANDLE )
+    {
+        vkDestroySemaphore( device_, frameTimeline_, nullptr );
+        frameTimeline_ = VK_NULL_HANDLE;
+    }
+
+    for( auto& frame : frames_ )
+    {
+        if( frame.inFlight != VK_NULL_HANDLE )
+        {
+            vkDestroyFence( device_, frame.inFlight, nullptr );
+            frame.inFlight = VK_NULL_HANDLE;
+        }
+        if( frame.imageAvailable != VK_NULL_HANDLE )
+        {
+            vkDestroySemaphore( device_, frame.imageAvailable, nullptr );
+            frame.imageAvailable = VK_NULL_HANDLE;
+        }
+        if( frame.computeFinished != VK_NULL_HANDLE )
+        {
+            vkDestroySemaphore( device_, frame.computeFinished, nullptr );
+            frame.computeFinished = VK_NULL_HANDLE;
+        }
+        frame.submittedFrames = 0;
+        frame.timingPending   = false;
+    }
+}
+
+bool VulkanRenderer::isFrameComplete( uint64_t frame )
+{
+    if( frame <= completedFrames_ )
+        return true;
+    if( frame > frameNumber_ || device_ == VK_NULL_HANDLE )
+        return false;
+
+    // The host owns the fences; frames are known to be complete only once their slot comes around again.
+    if( external_ )
+        return false;
+
+    if( timelineSync_ )
+    {
+        uint64_t value = 0;
+        VK_CHECK( dispatch_.vkGetSemaphoreCounterValueKHR( device_, frameTimeline_, &value ) );
+        completedFrames_ = std::max( completedFrames_, value );
+        return frame <= completedFrames_;
+    }
+
+    // A signaled slot fence means its frame and, by in-order completion, every earlier one finished.
+    for( uint32_t i = 0; i < framesInFlight_; ++i )
+    {
+        const FrameResources& slot = frames_[i];
+        if( slot.submittedFrames >= frame && dispatch_.vkGetFenceStatus( device_, slot.inFlight ) == VK_SUCCESS )
+        {
+            completedFrames_ = std::max( completedFrames_, slot.submittedFrames );
+        }
+    }
+    return frame <= completedFrames_;
+}
+
+bool VulkanRenderer::waitForFrame( uint64_t frame, uint64_t timeoutNs )
+{
+    if( frame <= completedFrames_ )
+        return true;
+    if( frame > frameNumber_ || device_ == VK_NULL_HANDLE )
+        return false;
+
+    // The host owns the fences; frames are known to be complete only once their slot comes around again.
+    if( external_ )
+        return false;
+
+    if( timelineSync_ )
+    {
+        VkSemaphoreWaitInfoKHR wi{};
+        wi.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+        wi.semaphoreCount = 1;
+        wi.pSemaphores    = &frameTimeline_;
+        wi.pValues        = &frame;
+
+        const VkResult res = dispatch_.vkWaitSemaphoresKHR( device_, &wi, timeoutNs );
+        if( res == VK_TIMEOUT )
+            return false;
+        VK_CHECK( res );
+
+        completedFrames_ = std::max( completedFrames_, frame );
+        return true;
+    }
+
+    // The oldest submission at or after the frame is the earliest fence that covers it. Slots only hold the last
+    // framesInFlight_ frames, so anything older is covered by the oldest slot.
+    const FrameResources* cover = nullptr;
+    for( uint32_t i = 0; i < framesInFlight_; ++i )
+    {
+        const FrameResources& slot = frames_[i];
+        if( slot.submittedFrames >= frame && ( cover == nullptr || slot.submittedFrames < cover->submittedFrames ) )
+            cover = &slot;
+    }
+    if( cover == nullptr )
+        return false;
+
+    const VkResult res = dispatch_.vkWaitForFences( device_, 1, &cover->inFlight, VK_TRUE, timeoutNs );
+    if( res == VK_TIMEOUT )
+        return false;
+    VK_CHECK( res );
+
+    completedFrames_ = std::max( completedFrames_, cover->submittedFrames );
+    return true;
+}
+
+void VulkanRenderer::deferDestroy( std::function<void()> destroy )
+{
+    // No device, no GPU work that could still reference the resource.
+    if( !initialized_ )
     {
-        vkDestroyFence( device_, inFlight_, nullptr );
-        inFlight_ = VK_NULL_HANDLE;
+        destroy();
+        return;
     }
-    if( renderFinished_ != VK_NULL_HANDLE )
+
+    // Everything submitted so far may still use the resource; it is safe once all of it has completed.
+    deletionQueue_.push_back( { frameNumber_, std::move( destroy ) } );
+}
+
+BindlessHandle VulkanRenderer::registerBindlessImage( VkImageView view, VkSampler sampler, VkImageLayout layout )
+{
+    return bindless_.registerImage( view, sampler, layout );
+}
+
+BindlessHandle VulkanRenderer::registerBindlessBuffer( VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range )
+{
+    return bindless_.registerBuffer( buffer, offset, range );
+}
+
+void VulkanRenderer::releaseBindlessImage( BindlessHandle handle )
+{
+    deferDestroy( [this, handle] { bindless_.releaseImage( handle ); } );
+}
+
+void VulkanRenderer::releaseBindlessBuffer( BindlessHandle handle )
+{
+    deferDestroy( [this, handle] { bindless_.releaseBuffer( handle ); } );
+}
+
+void VulkanRenderer::deferDestroyBuffer( VkBuffer buffer, GpuAllocation* allocation )
+{
+    deferDestroy( [allocator = &allocator_, buffer, allocation] { allocator->destroyBuffer( buffer, allocation ); } );
+}
+
+void VulkanRenderer::deferDestroyImage( VkImage image, GpuAllocation* allocation )
+{
+    deferDestroy( [allocator = &allocator_, image, allocation] { allocator->destroyImage( image, allocation ); } );
+}
+
+void VulkanRenderer::collectGarbage()
+{
+    // Entries are in frame order; only poll when the oldest one is not known to be safe yet.
+    if( !deletionQueue_.empty() && deletionQueue_.front().frame > completedFrames_ )
     {
-        vkDestroySemaphore( device_, renderFinished_, nullptr );
-        renderFinished_ = VK_NULL_HANDLE;
+        isFrameComplete( deletionQueue_.front().frame );
     }
-    if( imageAvailable_ != VK_NULL_HANDLE )
+
+    while( !deletionQueue_.empty() && deletionQueue_.front().frame <= completedFrames_ )
     {
-        vkDestroySemaphore( device_, imageAvailable_, nullptr );
-        imageAvailable_ = VK_NULL_HANDLE;
+        deletionQueue_.front().destroy();
+        deletionQueue_.pop_front();
     }
 }
 
-void VulkanRenderer::recordCommandBuffer( uint32_t imageIndex )
+void VulkanRenderer::flushDeletionQueue()
 {
-    VkCommandBuffer cmd = commandBuffers_[imageIndex];
+    for( auto& pending : deletionQueue_ )
+    {
+        pending.destroy();
+    }
+    deletionQueue_.clear();
+}
 
+void VulkanRenderer::recordCommandBuffer( VkCommandBuffer cmd, uint32_t imageIndex )
+{
     VkCommandBufferBeginInfo bi{};
     bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    VK_CHECK( vkBeginCommandBuffer( cmd, &bi ) );
+    bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK( dispatch_.vkBeginCommandBuffer( cmd, &bi ) );
+
+    // Uploads that finished since the last frame become visible to everything recorded below.
+    uploads_.acquire( cmd, frameNumber_ + 1, completedFrames_, frameWaitSemaphores_ );
+
+    const uint32_t queryBase = 2 * frameIndex_;
+    if( timestampPool_ != VK_NULL_HANDLE )
+    {
+        dispatch_.vkCmdResetQueryPool( cmd, timestampPool_, queryBase, 2 );
+        dispatch_.vkCmdWriteTimestamp( cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool_, queryBase );
+    }
+
+    const bool secondary = !recordJobs_.empty();
+    if( secondary )
+    {
+        recordSecondaryCommandBuffers( frames_[frameIndex_], imageIndex );
+    }
+
+    beginRendering( cmd, imageIndex, secondary );
+
+    if( secondary )
+    {
+        dispatch_.vkCmdExecuteCommands( cmd, static_cast<uint32_t>( secondaryBuffers_.size() ), secondaryBuffers_.data() );
+    }
+    else if( recordCallback_ )
+    {
+        recordCallback_( cmd );
+    }
+
+    endRendering( cmd, imageIndex );
+
+    if( timestampPool_ != VK_NULL_HANDLE )
+    {
+        dispatch_.vkCmdWriteTimestamp( cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool_, queryBase + 1 );
+    }
+
+    // After the end timestamp, so that readback does not count as render time.
+    if( capture_.hasPending() && captureSupported() )
+    {
+        capture_.record( cmd, swapchainImages_[imageIndex], headless_ ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                         swapchainExtent_, swapchainFormat_, frameNumber_ + 1 );
+    }
 
+    VK_CHECK( dispatch_.vkEndCommandBuffer( cmd ) );
+}
+
+void VulkanRenderer::beginRendering( VkCommandBuffer cmd, uint32_t imageIndex, bool secondary )
+{
     VkClearValue clear{};
     clear.color.float32[0] = 0.08f;
     clear.color.float32[1] = 0.10f;
     clear.color.float32[2] = 0.18f;
     clear.color.float32[3] = 1.0f;
 
-    VkRenderPassBeginInfo rpBegin{};
-    rpBegin.sType             = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    rpBegin.renderPass        = renderPass_;
-    rpBegin.framebuffer       = framebuffers_[imageIndex];
-    rpBegin.renderArea.offset = { 0, 0 };
-    rpBegin.renderArea.extent = swapchainExtent_;
-    rpBegin.clearValueCount   = 1;
-    rpBegin.pClearValues      = &clear;
+    if( !dynamicRendering_ )
+    {
+        VkRenderPassBeginInfo rpBegin{};
+        rpBegin.sType             = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        rpBegin.renderPass        = renderPass_;
+        rpBegin.framebuffer       = framebuffers_[imageIndex];
+        rpBegin.renderArea.offset = { 0, 0 };
+        rpBegin.renderArea.extent = swapchainExtent_;
+        rpBegin.clearValueCount   = 1;
+        rpBegin.pClearValues      = &clear;
+
+        dispatch_.vkCmdBeginRenderPass( cmd, &rpBegin,
+                                        secondary ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE );
+        return;
+    }
 
-    vkCmdBeginRenderPass( cmd, &rpBegin, VK_SUBPASS_CONTENTS_INLINE );
+    // What the render pass did implicitly: discard the old contents (initialLayout UNDEFINED) once the acquire
+    // semaphore, waited on at COLOR_ATTACHMENT_OUTPUT, has signaled.
+    VkImageMemoryBarrier toAttachment{};
+    toAttachment.sType                       = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    toAttachment.srcAccessMask               = 0;
+    toAttachment.dstAccessMask               = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    toAttachment.oldLayout                   = VK_IMAGE_LAYOUT_UNDEFINED;
+    toAttachment.newLayout                   = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    toAttachment.srcQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
+    toAttachment.dstQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
+    toAttachment.image                       = swapchainImages_[imageIndex];
+    toAttachment.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    toAttachment.subresourceRange.levelCount = 1;
+    toAttachment.subresourceRange.layerCount = 1;
+    dispatch_.vkCmdPipelineBarrier( cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0,
+                                    nullptr, 0, nullptr, 1, &toAttachment );
+
+    VkRenderingAttachmentInfoKHR color{};
+    color.sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    color.imageView   = swapchainImageViews_[imageIndex];
+    color.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    color.loadOp      = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color.storeOp     = VK_ATTACHMENT_STORE_OP_STORE;
+    color.clearValue  = clear;
+
+    VkRenderingInfoKHR ri{};
+    ri.sType                = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    ri.flags                = secondary ? static_cast<VkRenderingFlags>( VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR ) : 0;
+    ri.renderArea.offset    = { 0, 0 };
+    ri.renderArea.extent    = swapchainExtent_;
+    ri.layerCount           = 1;
+    ri.colorAttachmentCount = 1;
+    ri.pColorAttachments    = &color;
+
+    dispatch_.vkCmdBeginRenderingKHR( cmd, &ri );
+}
 
-    if( recordCallback_ )
+void VulkanRenderer::endRendering( VkCommandBuffer cmd, uint32_t imageIndex )
+{
+    if( !dynamicRendering_ )
     {
-        recordCallback_( cmd );
+        dispatch_.vkCmdEndRenderPass( cmd );
+        return;
     }
 
-    vkCmdEndRenderPass( cmd );
+    dispatch_.vkCmdEndRenderingKHR( cmd );
+
+    // The render pass's finalLayout transition.
+    VkImageMemoryBarrier toFinal{};
+    toFinal.sType                       = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    toFinal.srcAccessMask               = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    toFinal.dstAccessMask               = 0;
+    toFinal.oldLayout                   = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    toFinal.newLayout                   = headless_ ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    toFinal.srcQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
+    toFinal.dstQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
+    toFinal.image                       = swapchainImages_[imageIndex];
+    toFinal.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    toFinal.subresourceRange.levelCount = 1;
+    toFinal.subresourceRange.layerCount = 1;
+    dispatch_.vkCmdPipelineBarrier( cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                                    0, nullptr, 1, &toFinal );
+}
 
-    VK_CHECK( vkEndCommandBuffer( cmd ) );
+void VulkanRenderer::resetSecondaryCommandBuffers( FrameResources& frame )
+{
+    for( auto& commands : frame.threadCommands )
+    {
+        if( commands.used > 0 )
+        {
+            VK_CHECK( dispatch_.vkResetCommandPool( device_, commands.pool, 0 ) );
+            commands.used = 0;
+        }
+    }
 }
 
-void VulkanRenderer::drawFrame()
+VkCommandBuffer VulkanRenderer::nextSecondaryCommandBuffer( ThreadCommands& commands )
 {
-    if( !initialized_ )
-        return;
+    if( commands.used == commands.buffers.size() )
+    {
+        VkCommandBufferAllocateInfo cbai{};
+        cbai.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cbai.commandPool        = commands.pool;
+        cbai.level              = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        cbai.commandBufferCount = 1;
+
+        VkCommandBuffer cmd = VK_NULL_HANDLE;
+        VK_CHECK( dispatch_.vkAllocateCommandBuffers( device_, &cbai, &cmd ) );
+        commands.buffers.push_back( cmd );
+    }
+
+    return commands.buffers[commands.used++];
+}
 
-    if( swapchainDirty_ )
+void VulkanRenderer::recordSecondaryCommandBuffers( FrameResources& frame, uint32_t imageIndex )
+{
+    startRecordThreads();
+
+    const uint32_t jobCount = static_cast<uint32_t>( recordJobs_.size() );
+    const uint32_t count    = jobCount + ( recordCallback_ ? 1u : 0u );
+    secondaryBuffers_.assign( count, VK_NULL_HANDLE );
+
+    VkCommandBufferInheritanceRenderingInfoKHR renderingInheritance{};
+    renderingInheritance.sType                   = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+    renderingInheritance.colorAttachmentCount    = 1;
+    renderingInheritance.pColorAttachmentFormats = &swapchainFormat_;
+    renderingInheritance.rasterizationSamples    = VK_SAMPLE_COUNT_1_BIT;
+
+    VkCommandBufferInheritanceInfo inheritance{};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    if( dynamicRendering_ )
     {
-        vkDeviceWaitIdle( device_ );
+        inheritance.pNext = &renderingInheritance;
+    }
+    else
+    {
+        inheritance.renderPass  = renderPass_;
+        inheritance.subpass     = 0;
+        inheritance.framebuffer = framebuffers_[imageIndex];
+    }
 
-        if( !commandBuffers_.empty() )
+    VkCommandBufferBeginInfo bi{};
+    bi.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    bi.flags            = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    bi.pInheritanceInfo = &inheritance;
+
+    // Items are handed out dynamically, so a buffer comes from the pool of whichever thread records it.
+    workerPool_.parallelFor( count, [&]( uint32_t item, uint32_t threadIndex ) {
+        VkCommandBuffer cmd = nextSecondaryCommandBuffer( frame.threadCommands[threadIndex] );
+        VK_CHECK( dispatch_.vkBeginCommandBuffer( cmd, &bi ) );
+
+        if( item < jobCount )
+        {
+            recordJobs_[item].record( cmd );
+        }
+        else
         {
-            vkFreeCommandBuffers( device_, commandPool_, static_cast<uint32_t>( commandBuffers_.size() ), commandBuffers_.data() );
-            commandBuffers_.clear();
+            recordCallback_( cmd );
         }
 
-        destroySwapchain();
-        createSwapchain( width_, height_ );
-        createCommandResources();
+        VK_CHECK( dispatch_.vkEndCommandBuffer( cmd ) );
+        secondaryBuffers_[item] = cmd;
+    } );
+}
 
-        swapchainDirty_ = false;
-    }
+void VulkanRenderer::publishFrameTiming( FrameResources& frame )
+{
+    if( !frame.timingPending )
+        return;
 
-    VK_CHECK( vkWaitForFences( device_, 1, &inFlight_, VK_TRUE, UINT64_MAX ) );
-    VK_CHECK( vkResetFences( device_, 1, &inFlight_ ) );
+    frame.timingPending = false;
 
-    uint32_t imageIndex = 0;
-    VkResult acq        = vkAcquireNextImageKHR( device_, swapchain_, UINT64_MAX, imageAvailable_, VK_NULL_HANDLE, &imageIndex );
-    if( acq == VK_ERROR_OUT_OF_DATE_KHR )
+    if( timestampPool_ != VK_NULL_HANDLE )
     {
-        swapchainDirty_ = true;
-        return;
+        // The slot's fence has signaled, so the results are available and this never blocks.
+        const uint32_t slot = static_cast<uint32_t>( &frame - frames_.data() );
+        uint64_t ticks[2]   = {};
+        VkResult r          = dispatch_.vkGetQueryPoolResults( device_, timestampPool_, 2 * slot, 2, sizeof( ticks ), ticks,
+                                                               sizeof( uint64_t ), VK_QUERY_RESULT_64_BIT );
+        if( r == VK_SUCCESS )
+        {
+            const uint64_t mask  = timestampValidBits_ >= 64 ? ~0ull : ( ( 1ull << timestampValidBits_ ) - 1 );
+            const uint64_t delta = ( ( ticks[1] & mask ) - ( ticks[0] & mask ) ) & mask;
+            frame.timing[FramePhase::Gpu] = static_cast<double>( delta ) * timestampPeriod_ * 1e-6;
+        }
     }
-    if( acq != VK_SUCCESS && acq != VK_SUBOPTIMAL_KHR )
+
+    frameTimings_.push( frame.timing );
+}
+
+VkPipelineStageFlags VulkanRenderer::submitComputeJobs( FrameResources& frame )
+{
+    if( computeJobs_.empty() )
+        return 0;
+
+    // The slot's previous frame waited on its compute work, so the pool is idle once the frame has finished.
+    VK_CHECK( dispatch_.vkResetCommandPool( device_, frame.computePool, 0 ) );
+
+    VkCommandBufferBeginInfo bi{};
+    bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK( dispatch_.vkBeginCommandBuffer( frame.computeBuffer, &bi ) );
+
+    VkPipelineStageFlags dstStages = 0;
+    for( auto& job : computeJobs_ )
     {
-        VK_CHECK( acq );
+        job.record( frame.computeBuffer );
+        dstStages |= job.dstStages;
     }
+    computeJobs_.clear();
 
-    VK_CHECK( vkResetCommandBuffer( commandBuffers_[imageIndex], 0 ) );
-    recordCommandBuffer( imageIndex );
-
-    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    VK_CHECK( dispatch_.vkEndCommandBuffer( frame.computeBuffer ) );
 
     VkSubmitInfo si{};
     si.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    si.waitSemaphoreCount   = 1;
-    si.pWaitSemaphores      = &imageAvailable_;
-    si.pWaitDstStageMask    = &waitStage;
     si.commandBufferCount   = 1;
-    si.pCommandBuffers      = &commandBuffers_[imageIndex];
+    si.pCommandBuffers      = &frame.computeBuffer;
     si.signalSemaphoreCount = 1;
-    si.pSignalSemaphores    = &renderFinished_;
+    si.pSignalSemaphores    = &frame.computeFinished;
+    VK_CHECK( dispatch_.vkQueueSubmit( computeQueue_, 1, &si, VK_NULL_HANDLE ) );
 
-    VK_CHECK( vkQueueSubmit( queue_, 1, &si, inFlight_ ) );
+    return dstStages != 0 ? dstStages : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+}
+
+void VulkanRenderer::consumeFrameRequest()
+{
+    // One requested frame, unless invalidate() raced in with more.
+    uint32_t requested = requestedFrames_.load( std::memory_order_relaxed );
+    while( requested > 0 && !requestedFrames_.compare_exchange_weak( requested, requested - 1, std::memory_order_relaxed ) )
+    {
+    }
+}
+
+void VulkanRenderer::drawFrame()
+{
+    if( !initialized_ )
+        return;
 
-    VkPresentInfoKHR pi{};
-    pi.sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    pi.waitSemaphoreCount = 1;
-    pi.pWaitSemaphores    = &renderFinished_;
-    pi.swapchainCount     = 1;
-    pi.pSwapchains        = &swapchain_;
-    pi.pImageIndices      = &imageIndex;
+    if( external_ )
+    {
+        std::fprintf( stderr, "drawFrame is not used in external mode; the host calls beginExternalFrame/recordExternalFrame.\n" );
+        return;
+    }
 
-    VkResult pres = vkQueuePresentKHR( queue_, &pi );
-    if( pres == VK_ERROR_OUT_OF_DATE_KHR || pres == VK_SUBOPTIMAL_KHR )
+    if( renderThreadActive_ && tlsRenderThreadOwner != this )
     {
-        swapchainDirty_ = true;
+        std::fprintf( stderr, "drawFrame called while the render thread owns drawing; ignoring.\n" );
+        return;
+    }
+
+    if( !needsFrame() )
+    {
+        // Idle: only let finished frames release what they held. Nothing is submitted, so the GPU stays idle too.
+        if( completedFrames_ < frameNumber_ )
+        {
+            isFrameComplete( frameNumber_ );
+        }
+        collectGarbage();
+        capture_.deliver( completedFrames_ );
+        ++idleFrames_;
+        return;
+    }
+
+    const auto tStart = FrameClock::now();
+
+    double recreateMs = -1.0;
+    if( !applyPendingResize( recreateMs ) )
         return;
+
+    FrameResources& frame = frames_[frameIndex_];
+
+    // Only blocks when the GPU is more than framesInFlight_ frames behind. Submissions on one queue complete in
+    // order, so this slot's frame finishing implies all earlier ones did.
+    const auto tFenceWait = FrameClock::now();
+    waitForFrame( frame.submittedFrames );
+    if( timelineSync_ )
+    {
+        isFrameComplete( frameNumber_ ); // refresh completedFrames_ past this slot, for free
+    }
+    double fenceWaitMs = elapsedMs( tFenceWait, FrameClock::now() );
+
+    collectGarbage();
+    capture_.deliver( completedFrames_ );
+    descriptors_.beginFrame( frameIndex_ );
+
+    // GPU timestamps of the slot's previous frame are ready now; complete and publish its timing.
+    publishFrameTiming( frame );
+
+    FrameTiming timing;
+    timing.frame = frameNumber_;
+    timing.ms.fill( -1.0 );
+    timing[FramePhase::Recreate] = recreateMs;
+
+    // Headless targets are owned per frame slot, so the slot's fence already guards the image.
+    uint32_t imageIndex = frameIndex_;
+    const auto tAcquire = FrameClock::now();
+    if( !headless_ )
+    {
+        VkResult acq =
+            dispatch_.vkAcquireNextImageKHR( device_, swapchain_, UINT64_MAX, frame.imageAvailable, VK_NULL_HANDLE, &imageIndex );
+        if( acq == VK_ERROR_OUT_OF_DATE_KHR )
+        {
+            markSwapchainDirty( true );
+            return;
+        }
+        if( acq == VK_SUBOPTIMAL_KHR )
+        {
+            markSwapchainDirty( false );
+        }
+        else if( acq != VK_SUCCESS )
+        {
+            VK_CHECK( acq );
+        }
+
+        timing[FramePhase::Acquire] = elapsedMs( tAcquire, FrameClock::now() );
+
+        // The swapchain may hand out images out of order; make sure no older frame still renders to this one.
+        const auto tImageWait = FrameClock::now();
+        waitForFrame( imageFrames_[imageIndex] );
+        fenceWaitMs += elapsedMs( tImageWait, FrameClock::now() );
+        imageFrames_[imageIndex] = frameNumber_ + 1;
+    }
+    timing[FramePhase::FenceWait] = fenceWaitMs; // only the waits, not the per-frame bookkeeping between them
+
+    // From here on the frame is submitted, so it may count against a request. Skipped frames (pending resize, out of
+    // date swapchain) return above and leave the request for the next call. Consumed before recording, so an
+    // invalidate() from a record callback asks for another frame.
+    consumeFrameRequest();
+
+    // Reset only once we know we will submit, otherwise an early return would leave the fence unsignaled forever.
+    if( !timelineSync_ )
+    {
+        VK_CHECK( dispatch_.vkResetFences( device_, 1, &frame.inFlight ) );
+    }
+
+    // Kick off uploads queued since the last frame; they complete asynchronously on the transfer queue.
+    uploads_.submit();
+
+    frameWaitSemaphores_.clear();
+    frameWaitStages_.clear();
+    if( !headless_ )
+    {
+        frameWaitSemaphores_.push_back( frame.imageAvailable );
+        frameWaitStages_.push_back( VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT );
+    }
+
+    // Goes ahead of the graphics submit, which waits for it only where the results are consumed.
+    if( const VkPipelineStageFlags computeStages = submitComputeJobs( frame ) )
+    {
+        frameWaitSemaphores_.push_back( frame.computeFinished );
+        frameWaitStages_.push_back( computeStages );
+    }
+
+    const auto tRecord = FrameClock::now();
+    VK_CHECK( dispatch_.vkResetCommandPool( device_, frame.commandPool, 0 ) );
+    resetSecondaryCommandBuffers( frame );
+    recordCommandBuffer( frame.commandBuffer, imageIndex );
+
+    // Upload semaphores (appended while recording) are already signaled and only order their writes before this frame.
+    frameWaitStages_.resize( frameWaitSemaphores_.size(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT );
+
+    VkSubmitInfo si{};
+    si.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    si.commandBufferCount = 1;
+    si.pCommandBuffers    = &frame.commandBuffer;
+    si.waitSemaphoreCount = static_cast<uint32_t>( frameWaitSemaphores_.size() );
+    si.pWaitSemaphores    = frameWaitSemaphores_.data();
+    si.pWaitDstStageMask  = frameWaitStages_.data();
+
+    // Binary semaphores ignore their entry in the value array.
+    const uint64_t signalValues[2] = { 0, frameNumber_ + 1 };
+    VkSemaphore signals[2]         = { headless_ ? VK_NULL_HANDLE : renderFinished_[imageIndex], frameTimeline_ };
+    const uint32_t firstSignal     = headless_ ? 1 : 0;
+    const uint32_t signalEnd       = timelineSync_ ? 2 : 1;
+
+    VkTimelineSemaphoreSubmitInfoKHR tsi{};
+    tsi.sType                     = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    tsi.signalSemaphoreValueCount = signalEnd - firstSignal;
+    tsi.pSignalSemaphoreValues    = signalValues + firstSignal;
+
+    si.pNext                = timelineSync_ ? &tsi : nullptr;
+    si.signalSemaphoreCount = signalEnd - firstSignal;
+    si.pSignalSemaphores    = signals + firstSignal;
+
+    const auto tSubmit         = FrameClock::now();
+    timing[FramePhase::Record] = elapsedMs( tRecord, tSubmit );
+    VK_CHECK( dispatch_.vkQueueSubmit( queue_, 1, &si, frame.inFlight ) );
+    timing[FramePhase::Submit] = elapsedMs( tSubmit, FrameClock::now() );
+
+    ++frameNumber_;
+    frame.submittedFrames = frameNumber_;
+    frameIndex_           = ( frameIndex_ + 1 ) % framesInFlight_;
+
+    if( !headless_ )
+    {
+        VkPresentInfoKHR pi{};
+        pi.sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        pi.waitSemaphoreCount = 1;
+        pi.pWaitSemaphores    = &renderFinished_[imageIndex];
+        pi.swapchainCount     = 1;
+        pi.pSwapchains        = &swapchain_;
+        pi.pImageIndices      = &imageIndex;
+
+        const auto tPresent         = FrameClock::now();
+        VkResult pres               = dispatch_.vkQueuePresentKHR( queue_, &pi );
+        timing[FramePhase::Present] = elapsedMs( tPresent, FrameClock::now() );
+
+        if( pres == VK_ERROR_OUT_OF_DATE_KHR || pres == VK_SUBOPTIMAL_KHR )
+        {
+            markSwapchainDirty( pres == VK_ERROR_OUT_OF_DATE_KHR );
+        }
+        else
+        {
+            VK_CHECK( pres );
+        }
     }
-    VK_CHECK( pres );
+
+    // Published once the slot comes around again and its GPU timestamps can be read without waiting.
+    timing[FramePhase::CpuTotal] = elapsedMs( tStart, FrameClock::now() );
+    frame.timing                 = timing;
+    frame.timingPending          = true;
 }
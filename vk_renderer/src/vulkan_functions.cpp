@@ -0,0 +1,116 @@
+#include "vk_check.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vk_renderer/vulkan_functions.hpp>
+
+#if defined( VK_NO_PROTOTYPES )
+#include <dlfcn.h>
+#endif
+
+bool DeviceDispatch::load( VkDevice device )
+{
+    *this = DeviceDispatch{};
+
+    bool complete = true;
+#define VK_RENDERER_LOAD_CORE( name )                                                                                                      \
+    name = reinterpret_cast<PFN_##name>( vkGetDeviceProcAddr( device, #name ) );                                                           \
+    if( name == nullptr )                                                                                                                  \
+    {                                                                                                                                      \
+        std::fprintf( stderr, "vkGetDeviceProcAddr: %s not found.\n", #name );                                                             \
+        complete = false;                                                                                                                  \
+    }
+#define VK_RENDERER_LOAD_EXTENSION( name ) name = reinterpret_cast<PFN_##name>( vkGetDeviceProcAddr( device, #name ) );
+    VK_RENDERER_DEVICE_FUNCTIONS( VK_RENDERER_LOAD_CORE )
+    VK_RENDERER_SWAPCHAIN_FUNCTIONS( VK_RENDERER_LOAD_EXTENSION )
+    VK_RENDERER_DEVICE_EXTENSION_FUNCTIONS( VK_RENDERER_LOAD_EXTENSION )
+#undef VK_RENDERER_LOAD_EXTENSION
+#undef VK_RENDERER_LOAD_CORE
+    return complete;
+}
+
+#if defined( VK_NO_PROTOTYPES )
+
+#define VK_RENDERER_DEFINE_FUNCTION( name ) PFN_##name name = nullptr;
+PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr = nullptr;
+VK_RENDERER_GLOBAL_FUNCTIONS( VK_RENDERER_DEFINE_FUNCTION )
+VK_RENDERER_INSTANCE_FUNCTIONS( VK_RENDERER_DEFINE_FUNCTION )
+VK_RENDERER_METAL_FUNCTIONS( VK_RENDERER_DEFINE_FUNCTION )
+VK_RENDERER_DEVICE_FUNCTIONS( VK_RENDERER_DEFINE_FUNCTION )
+VK_RENDERER_SWAPCHAIN_FUNCTIONS( VK_RENDERER_DEFINE_FUNCTION )
+#undef VK_RENDERER_DEFINE_FUNCTION
+
+static void* openVulkanLibrary( const char* path )
+{
+    if( path == nullptr )
+        path = std::getenv( "VK_RENDERER_VULKAN_LIBRARY" );
+    if( path != nullptr && path[0] != '\0' )
+        return dlopen( path, RTLD_NOW | RTLD_LOCAL );
+
+#if defined( __APPLE__ )
+    // MoltenVK exports the Vulkan entry points itself, so it can stand in for the loader (no layers then).
+    const char* candidates[] = { "libvulkan.1.dylib", "libvulkan.dylib", "libMoltenVK.dylib" };
+#else
+    const char* candidates[] = { "libvulkan.so.1", "libvulkan.so" };
+#endif
+    for( const char* candidate : candidates )
+    {
+        if( void* library = dlopen( candidate, RTLD_NOW | RTLD_LOCAL ) )
+            return library;
+    }
+    return nullptr;
+}
+
+bool loadVulkanLibrary( const char* path )
+{
+    static const bool loaded = [&]
+    {
+        void* library = openVulkanLibrary( path );
+        if( library == nullptr )
+        {
+            std::fprintf( stderr, "Failed to load the Vulkan library: %s\n", dlerror() );
+            return false;
+        }
+
+        vkGetInstanceProcAddr = reinterpret_cast<PFN_vkGetInstanceProcAddr>( dlsym( library, "vkGetInstanceProcAddr" ) );
+        if( vkGetInstanceProcAddr == nullptr )
+        {
+            std::fprintf( stderr, "The Vulkan library does not export vkGetInstanceProcAddr.\n" );
+            dlclose( library );
+            return false;
+        }
+
+#define VK_RENDERER_LOAD_GLOBAL( name ) name = reinterpret_cast<PFN_##name>( vkGetInstanceProcAddr( VK_NULL_HANDLE, #name ) );
+        VK_RENDERER_GLOBAL_FUNCTIONS( VK_RENDERER_LOAD_GLOBAL )
+#undef VK_RENDERER_LOAD_GLOBAL
+        return vkCreateInstance != nullptr;
+    }();
+    return loaded;
+}
+
+void loadVulkanInstanceFunctions( VkInstance instance )
+{
+#define VK_RENDERER_LOAD_INSTANCE( name ) name = reinterpret_cast<PFN_##name>( vkGetInstanceProcAddr( instance, #name ) );
+    VK_RENDERER_INSTANCE_FUNCTIONS( VK_RENDERER_LOAD_INSTANCE )
+    VK_RENDERER_METAL_FUNCTIONS( VK_RENDERER_LOAD_INSTANCE )
+    // Device-level functions stay on the instance's trampolines, which dispatch on the handle and so work for every
+    // device; the per-frame paths use a DeviceDispatch instead.
+    VK_RENDERER_DEVICE_FUNCTIONS( VK_RENDERER_LOAD_INSTANCE )
+    VK_RENDERER_SWAPCHAIN_FUNCTIONS( VK_RENDERER_LOAD_INSTANCE )
+#undef VK_RENDERER_LOAD_INSTANCE
+}
+
+#else
+
+bool loadVulkanLibrary( const char* path )
+{
+    (void)path;
+    return true;
+}
+
+void loadVulkanInstanceFunctions( VkInstance instance )
+{
+    (void)instance;
+}
+
+#endif
@@ -0,0 +1,105 @@
+#include <vk_renderer/worker_pool.hpp>
+
+WorkerPool::~WorkerPool()
+{
+    stop();
+}
+
+uint32_t WorkerPool::defaultWorkerCount()
+{
+    const uint32_t hw = std::thread::hardware_concurrency();
+    return hw > 1 ? hw - 1 : 0;
+}
+
+void WorkerPool::start( uint32_t workerCount )
+{
+    stop();
+
+    stopping_ = false;
+    workers_.reserve( workerCount );
+    for( uint32_t i = 0; i < workerCount; ++i )
+    {
+        workers_.emplace_back( &WorkerPool::workerLoop, this, i + 1 );
+    }
+}
+
+void WorkerPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+        stopping_ = true;
+    }
+    wake_.notify_all();
+
+    for( auto& t : workers_ )
+    {
+        t.join();
+    }
+    workers_.clear();
+}
+
+void WorkerPool::parallelFor( uint32_t count, const Task& task )
+{
+    if( count == 0 )
+        return;
+
+    // Waking workers costs more than it saves for a single item.
+    if( workers_.empty() || count == 1 )
+    {
+        for( uint32_t i = 0; i < count; ++i )
+        {
+            task( i, 0 );
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+        task_  = &task;
+        count_ = count;
+        next_.store( 0, std::memory_order_relaxed );
+        busy_ = static_cast<uint32_t>( workers_.size() );
+        ++generation_;
+    }
+    wake_.notify_all();
+
+    drain( 0 );
+
+    std::unique_lock<std::mutex> lock( mutex_ );
+    done_.wait( lock, [this] { return busy_ == 0; } );
+    task_ = nullptr;
+}
+
+void WorkerPool::workerLoop( uint32_t threadIndex )
+{
+    uint64_t seen = 0;
+    for( ;; )
+    {
+        {
+            std::unique_lock<std::mutex> lock( mutex_ );
+            wake_.wait( lock, [&] { return stopping_ || generation_ != seen; } );
+            if( stopping_ )
+                return;
+            seen = generation_;
+        }
+
+        drain( threadIndex );
+
+        std::lock_guard<std::mutex> lock( mutex_ );
+        if( --busy_ == 0 )
+        {
+            done_.notify_one();
+        }
+    }
+}
+
+void WorkerPool::drain( uint32_t threadIndex )
+{
+    for( ;; )
+    {
+        const uint32_t item = next_.fetch_add( 1, std::memory_order_relaxed );
+        if( item >= count_ )
+            break;
+        ( *task_ )( item, threadIndex );
+    }
+}